@@ -4,33 +4,50 @@
 #ifndef CURRENT_H
 #define CURRENT_H
 #include "sensor.hpp"//  Include the parent sensor
+#include "adcStream.hpp"//  Include the free running ADC stream
+#include "fixed.hpp"//  Readings are converted with fixed point maths
+#include "windowStats.hpp"//  The min, max and ripple between reports
+
+//  The values a current sensor reports with window statistics turned on, in this order
+#define CURRENT_VALUES 5    //  Its report, then the window's min, max, RMS and standard deviation
 
 namespace Sensor {
     class CurrentSensor : public Sensor {
     private:
         int readings;       //  Stores the number of readings taken since the last report
         long totalReading;  //  Stores the sum of the readings taken since the last report
-        uint8_t Vref;
-        uint8_t Vout;
-        double off;         //  Offset and gradient, used to calibrate the current sensor
-        double grad;        //  so accurate current readings can be calculated from the voltage it outputs
+        AnalogInput Vref;   //  The current sensor reference and output voltage pins
+        AnalogInput Vout;
+        Fixed off;          //  Offset and gradient, used to calibrate the current sensor
+        Fixed grad;         //  so accurate current readings can be calculated from the voltage it outputs
+        bool freeRunning;   //  Whether samples come from the free running ADC stream rather than analogRead
+        bool windowStats;   //  Whether the min, max, RMS and deviation are reported as well
+        WindowStats window; //  The statistics of the samples taken since the last report
+        void addSample(int16_t diff);
+        void drain();
     public:
-        CurrentSensor(uint8_t pin1, uint8_t pin2, double offset, double gradient);  //  Called when a new sensor object is created
+        CurrentSensor(uint8_t pin1, uint8_t pin2, double offset, double gradient, bool stream = false);  //  Called when a new sensor object is created
         ~CurrentSensor();   //  Called when a sensor object is destroyed
         void setup();       //  Connects to the ADC chip and sets it up
         void tick();        //  Both called by the sensor manager
         double report();
+        void attach(Acquisition& acquisition);
+        void setWindowStats(bool enabled);
+        uint8_t getValueCount();
+        void reportValues(double* values);
+        Fixed reportFixed();    //  The average differential reading, without any floating point maths
+        Fixed calibrate(Fixed reading); //  Applies the offset and gradient to a reading
     };
 
-    CurrentSensor::CurrentSensor(uint8_t pin1, uint8_t pin2, double offset, double gradient) {
+    CurrentSensor::CurrentSensor(uint8_t pin1, uint8_t pin2, double offset, double gradient, bool stream) : Vref(pin1), Vout(pin2) {
         totalReading = 0;   //  Initialise readings to 0
         readings = 0;       //  Initialise readings to 0
-        Vref = pin1;
-        Vout = pin2;
-        pinMode(Vref, INPUT);
-        pinMode(Vout, INPUT);
-        off = offset;       //  Store the calibrated offset
-        grad = gradient;    // Store gradient
+        pinMode(pin1, INPUT);
+        pinMode(pin2, INPUT);
+        off = Fixed(offset);    //  Store the calibrated offset
+        grad = Fixed(gradient); // Store gradient
+        freeRunning = stream;   //  Store whether to use the ADC stream, it is started in setup
+        windowStats = false;
     }
 
     CurrentSensor::~CurrentSensor() {
@@ -38,27 +55,114 @@ namespace Sensor {
     }
 
     void CurrentSensor::setup() {
-        //
+        //  Start the ADC free running if asked to, falling back to analogRead if the board can't
+        if (freeRunning) {
+            freeRunning = adcStream.start(Vref.getPin(), Vout.getPin());
+        }
+    }
+
+    void CurrentSensor::attach(Acquisition& acquisition) {
+        //  Read both pins in the sensor manager's acquisition pass, so they are taken back to back
+        //  The free running stream reads the pins itself
+        if (!freeRunning) {
+            Vref.attach(acquisition);
+            Vout.attach(acquisition);
+        }
+    }
+
+    void CurrentSensor::addSample(int16_t diff) {
+        //  Samples go through the filter if there is one, otherwise into a plain average
+        //  The window statistics see every sample either way, negated like the report
+        if (windowStats) window.add(-diff);
+        if (filter != NULL) {
+            filter->push(diff);
+            return;
+        }
+        totalReading += diff;   //  Adds the reading to the running total
+        readings++;
+    }
+
+    void CurrentSensor::drain() {
+        //  Adds every sample pair the ADC stream has queued to the running total
+        AdcSample sample;
+        while (adcStream.read(sample)) {
+            addSample(sample.out - sample.ref);
+        }
     }
 
     void CurrentSensor::tick() {
         //  Called by the sensor manager whenever a new reading needs adding to the average
+        if (freeRunning) {
+            //  The interrupt has already taken the readings, so just collect them
+            drain();
+            return;
+        }
+
         //  Compares pins 0 and 1 during the reading, to make a differential measurement
         int16_t ref_reading;
         int16_t out_reading;
-        ref_reading = analogRead(Vref); //  Pin 0 should be the current sensor reference voltage
-        out_reading = analogRead(Vout); //  Pin 1 should be the current sensor output voltage
+        ref_reading = Vref.read(); //  Pin 0 should be the current sensor reference voltage
+        out_reading = Vout.read(); //  Pin 1 should be the current sensor output voltage
         int16_t diff_reading = out_reading - ref_reading; //  The readings aren't accurate enough if the ADC isn't used in differential mode
-        totalReading += diff_reading;   //  Adds the reading to the running total
-        readings++;
+        addSample(diff_reading);
     }
 
     double CurrentSensor::report() {
         //  Called by the sensor manager whenever an average reading should be reported
-        double current = -1*(double)totalReading / (double)readings; //  average V reading
+        return reportFixed().toDouble();    //  Return the current to the sensor manager
+    }
+
+    void CurrentSensor::setWindowStats(bool enabled) {
+        //  Reports the samples' min, max, RMS and standard deviation after the average, see CURRENT_VALUES
+        //  They are in the same units as the report, before calibration, so must be set before the sensor is added
+        windowStats = enabled;
+        window.reset();
+    }
+
+    uint8_t CurrentSensor::getValueCount() {
+        return windowStats ? CURRENT_VALUES : 1;
+    }
+
+    void CurrentSensor::reportValues(double* values) {
+        //  Reporting takes the last of the stream's samples, so the window is complete after it
+        values[0] = report();
+        if (!windowStats) return;
+        if (window.getCount() == 0) {
+            //  No samples since the last report
+            for (int i = 1; i < CURRENT_VALUES; i++) {
+                values[i] = NAN;
+            }
+            return;
+        }
+        values[1] = window.getMin();
+        values[2] = window.getMax();
+        values[3] = window.getRms();
+        values[4] = window.getDeviation();
+        window.reset();
+    }
+
+    Fixed CurrentSensor::reportFixed() {
+        if (freeRunning) {
+            drain();    //  Include the samples taken since the last tick
+        }
+        Fixed current;
+        if (filter != NULL) {
+            if (filter->ready()) current = -filter->output();
+        } else if (readings > 0) {
+            current = -Fixed::ratio(totalReading, readings); //  average V reading
+        }
         totalReading = 0;   //  Reset the running totals ready for the next average to be computed
         readings = 0;
-        return current;     //  Return the current to the sensor manager
+        return current;
+    }
+
+    Fixed CurrentSensor::calibrate(Fixed reading) {
+        //  Converts an average reading into a current using the calibration table if there is one,
+        //  otherwise the calibrated gradient and offset
+        if (calibration != NULL) {
+            return calibration->convert(reading);
+        }
+        return reading * grad + off;
     }
 }
 
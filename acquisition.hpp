@@ -0,0 +1,319 @@
+// Acquisition reads every analog and digital input the sensors use in one ordered pass
+// into a snapshot, so sensors due at the same time convert readings taken at the same instant
+// and no pin is read twice
+
+//  A header guard prevents the file from being included twice
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+#include "adcStream.hpp"
+#if defined(ARDUINO) && defined(__AVR__)
+#include <avr/sleep.h>
+#endif
+
+//  The max number of inputs, each one is a bit in a 16 bit channel mask
+#define ACQUISITION_CHANNELS 16
+
+//  How long to wait after starting a conversion before selecting the next channel,
+//  the channel is only locked in a couple of ADC clocks after the start (128 CPU cycles each)
+#define ACQUISITION_MUX_HOLD_US 16
+
+namespace Sensor {
+    class Acquisition {
+    private:
+        struct Input {
+            uint8_t pin;        //  The pin (or ADC channel for analog inputs)
+            bool analog;        //  Whether the input is read with the ADC
+#ifdef portInputRegister
+            volatile uint8_t* port;     //  The input register and bit for digital pins,
+            uint8_t bit;                //  looked up once rather than on every read
+#endif
+        };
+
+        Input inputs[ACQUISITION_CHANNELS];     //  The inputs, indexed by their channel
+        int16_t values[ACQUISITION_CHANNELS];   //  The snapshot of the last reading from each input
+        uint8_t order[ACQUISITION_CHANNELS];    //  The channels in the order they're read, analog first by pin
+        uint8_t channelCount;   //  The number of inputs added
+        uint16_t addedMask;     //  The channels added (or shared) since takeAddedMask was last called
+        uint32_t timestamp;    //  When the last scan started (micros)
+        bool adcSleep;      //  Whether analog inputs are converted in ADC noise reduction sleep
+
+        int add(uint8_t pin, bool analog);
+        void scanAnalog(uint16_t mask);
+        void scanAnalogAsleep(uint16_t mask);
+    public:
+        Acquisition();
+        ~Acquisition();
+        int addAnalog(uint8_t pin);
+        int addDigital(uint8_t pin);
+        uint16_t takeAddedMask();
+        void setAdcSleep(bool enabled);
+        void scan(uint16_t mask = 0xFFFF);
+        int16_t get(int channel);
+        uint32_t getTimestamp();
+    };
+
+    Acquisition::Acquisition() {
+        channelCount = 0;
+        addedMask = 0;
+        timestamp = 0;
+        adcSleep = false;
+    }
+
+    Acquisition::~Acquisition() {
+        //  Don't need to do anything when the object is destroyed
+    }
+
+    int Acquisition::add(uint8_t pin, bool analog) {
+        //  Inputs on the same pin share a channel, so the pin is only read once
+        for (int i = 0; i < channelCount; i++) {
+            if (inputs[i].pin == pin && inputs[i].analog == analog) {
+                addedMask |= 1 << i;
+                return i;
+            }
+        }
+        if (channelCount >= ACQUISITION_CHANNELS) {
+            RAISE_ARG(ERR_TOO_MANY_CHANNELS, pin);
+            return -1;
+        }
+
+        int channel = channelCount;
+        channelCount++;
+        inputs[channel].pin = pin;
+        inputs[channel].analog = analog;
+#ifdef portInputRegister
+        if (!analog) {
+            inputs[channel].port = portInputRegister(digitalPinToPort(pin));
+            inputs[channel].bit = digitalPinToBitMask(pin);
+        }
+#endif
+        values[channel] = 0;
+        if (!analog) {
+            //  Digital inputs start with a real read, as 0 is LOW, which sensors polling
+            //  the snapshot before the first scan would take as a change (e.g. a button press)
+            values[channel] = digitalRead(pin);
+            RECORD_INPUT(RECORD_DIGITAL, pin, values[channel]);
+        }
+        addedMask |= 1 << channel;
+
+        //  Insert the channel into the read order, analog inputs first and in pin order
+        //  so the multiplexer steps through the pins in one direction
+        int i = channel;
+        while (i > 0) {
+            Input& previous = inputs[order[i - 1]];
+            bool after = previous.analog != analog ? previous.analog : previous.pin <= pin;
+            if (after) break;
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = channel;
+        return channel;
+    }
+
+    int Acquisition::addAnalog(uint8_t pin) {
+#ifdef A0
+        //  Allow pins to be passed in as either A0 or 0, like analogRead does
+        if (pin >= A0) pin -= A0;
+#endif
+        return add(pin, true);
+    }
+
+    int Acquisition::addDigital(uint8_t pin) {
+        return add(pin, false);
+    }
+
+    uint16_t Acquisition::takeAddedMask() {
+        //  Used by the sensor manager to find out which channels a sensor uses
+        uint16_t mask = addedMask;
+        addedMask = 0;
+        return mask;
+    }
+
+    void Acquisition::setAdcSleep(bool enabled) {
+        //  Converts each analog input with the CPU asleep, so its noise doesn't get into the readings
+        //  It wakes on the ADC interrupt, so is ignored unless SENSOR_ADC_STREAM is defined, and on boards without the sleep mode
+        adcSleep = enabled;
+    }
+
+    void Acquisition::scanAnalogAsleep(uint16_t mask) {
+#if defined(SLEEP_MODE_ADC) && defined(ADC_STREAM_AVAILABLE)
+        //  Each conversion starts as the CPU goes to sleep and its interrupt wakes it again,
+        //  so the inputs can't be pipelined like they are awake
+        ADCSRA |= _BV(ADIE);
+        set_sleep_mode(SLEEP_MODE_ADC);
+        for (int i = 0; i < channelCount; i++) {
+            int channel = order[i];
+            if (!inputs[channel].analog || !(mask & (1 << channel))) continue;
+            ADMUX = _BV(REFS0) | inputs[channel].pin;   //  AVcc reference, the same as analogRead's default
+            cli();
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            //  Any other interrupt wakes the CPU early, so sleep again until the conversion is done
+            //  Interrupts are only turned back on straight before sleeping, so the conversion can't finish in between
+            while (true) {
+                cli();
+                if (!(ADCSRA & _BV(ADSC))) break;
+                sei();
+                sleep_cpu();
+            }
+            sei();
+            sleep_disable();
+            values[channel] = ADC;
+        }
+        ADCSRA &= ~_BV(ADIE);
+#endif
+    }
+
+    void Acquisition::scanAnalog(uint16_t mask) {
+#if defined(SLEEP_MODE_ADC) && defined(ADC_STREAM_AVAILABLE)
+        if (adcSleep) {
+            scanAnalogAsleep(mask);
+            return;
+        }
+#endif
+#if defined(ADCSRA) && defined(ADMUX)
+        //  Reads the analog inputs one after the other, selecting the next channel while
+        //  the current one converts, so each input has a whole conversion to settle on the multiplexer
+        int previous = -1;
+        for (int i = 0; i < channelCount; i++) {
+            int channel = order[i];
+            if (!inputs[channel].analog || !(mask & (1 << channel))) continue;
+            if (previous < 0) {
+                ADMUX = _BV(REFS0) | inputs[channel].pin;   //  AVcc reference, the same as analogRead's default
+            } else {
+                //  Select this channel for the next conversion, then wait for the previous one to finish
+                delayMicroseconds(ACQUISITION_MUX_HOLD_US);
+                ADMUX = _BV(REFS0) | inputs[channel].pin;
+                while (ADCSRA & _BV(ADSC)) {}
+                values[previous] = ADC;
+            }
+            ADCSRA |= _BV(ADSC);
+            previous = channel;
+        }
+        if (previous >= 0) {
+            while (ADCSRA & _BV(ADSC)) {}
+            values[previous] = ADC;
+        }
+#else
+        for (int i = 0; i < channelCount; i++) {
+            int channel = order[i];
+            if (inputs[channel].analog && (mask & (1 << channel))) {
+                values[channel] = analogRead(inputs[channel].pin);
+            }
+        }
+#endif
+    }
+
+    void Acquisition::scan(uint16_t mask) {
+        //  Reads the channels in the mask into the snapshot
+        timestamp = micros();
+
+        //  A free running ADC stream would fight over the ADC, so it is paused for the scan
+        bool paused = adcStream.pause();
+        scanAnalog(mask);
+        if (paused) adcStream.resume();
+
+        for (int i = 0; i < channelCount; i++) {
+            int channel = order[i];
+            if (inputs[channel].analog || !(mask & (1 << channel))) continue;
+#ifdef portInputRegister
+            values[channel] = (*inputs[channel].port & inputs[channel].bit) ? HIGH : LOW;
+#else
+            values[channel] = digitalRead(inputs[channel].pin);
+#endif
+        }
+
+#ifdef SENSOR_RECORD
+        //  Record the whole scan once it is done, so recording doesn't change the timing between reads
+        for (int i = 0; i < channelCount; i++) {
+            int channel = order[i];
+            if (mask & (1 << channel)) {
+                RECORD_INPUT(inputs[channel].analog ? RECORD_ANALOG : RECORD_DIGITAL, inputs[channel].pin, values[channel]);
+            }
+        }
+#endif
+    }
+
+    int16_t Acquisition::get(int channel) {
+        return values[channel];
+    }
+
+    uint32_t Acquisition::getTimestamp() {
+        return timestamp;
+    }
+
+    //  An analog input pin that a sensor reads from
+    //  Once attached to an acquisition it reads from the snapshot, otherwise it reads the pin itself
+    class AnalogInput {
+    private:
+        uint8_t pin;
+        int channel;
+        Acquisition* source;
+    public:
+        AnalogInput(uint8_t inputPin);
+        void attach(Acquisition& acquisition);
+        int read();
+        uint8_t getPin();
+    };
+
+    AnalogInput::AnalogInput(uint8_t inputPin) {
+        pin = inputPin;
+        channel = -1;
+        source = NULL;
+    }
+
+    void AnalogInput::attach(Acquisition& acquisition) {
+        channel = acquisition.addAnalog(pin);
+        if (channel >= 0) {
+            source = &acquisition;
+        }
+    }
+
+    int AnalogInput::read() {
+        if (source != NULL) return source->get(channel);
+        return adcStream.analogRead(pin);
+    }
+
+    uint8_t AnalogInput::getPin() {
+        return pin;
+    }
+
+    //  A digital input pin that a sensor reads from, in the same way as an analog input
+    class DigitalInput {
+    private:
+        uint8_t pin;
+        int channel;
+        Acquisition* source;
+    public:
+        DigitalInput(uint8_t inputPin);
+        void attach(Acquisition& acquisition);
+        int read();
+        uint8_t getPin();
+    };
+
+    DigitalInput::DigitalInput(uint8_t inputPin) {
+        pin = inputPin;
+        channel = -1;
+        source = NULL;
+    }
+
+    void DigitalInput::attach(Acquisition& acquisition) {
+        channel = acquisition.addDigital(pin);
+        if (channel >= 0) {
+            source = &acquisition;
+        }
+    }
+
+    int DigitalInput::read() {
+        if (source != NULL) return source->get(channel);
+        int level = digitalRead(pin);
+        RECORD_INPUT(RECORD_DIGITAL, pin, level);
+        return level;
+    }
+
+    uint8_t DigitalInput::getPin() {
+        return pin;
+    }
+}
+
+#endif
@@ -0,0 +1,216 @@
+// ADC stream runs the ADC in free running mode, alternating between a reference and an output pin
+// Each conversion complete interrupt stores a sample, and pairs of samples are queued in a ring buffer
+// that the current sensor drains on its ticks, so no time is spent waiting on analogRead
+// The stream needs the ADC conversion complete interrupt, which is only taken if SENSOR_ADC_STREAM
+// is defined before any sensor is included, otherwise start() returns false and the current sensor uses analogRead
+
+//  A header guard prevents the file from being included twice
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+#include "check.hpp"
+#include "record.hpp"
+
+//  The number of sample pairs the ring buffer holds, must be a power of 2
+//  At the default prescaler the stream produces about 4800 pairs a second,
+//  so the buffer needs draining at least every 6 milliseconds
+#define ADC_STREAM_SIZE 32
+
+//  Whether the stream can run, on boards with the ADC interrupt when it has been asked for
+#if defined(SENSOR_ADC_STREAM) && defined(ADCSRA) && defined(ADC_vect)
+#define ADC_STREAM_AVAILABLE
+#endif
+
+//  How long to wait after starting the first conversion before selecting the channel for the second,
+//  the channel can only be changed an ADC clock (128 CPU cycles) after the start
+#define ADC_STREAM_MUX_HOLD_US 16
+
+namespace Sensor {
+    //  A reference and output sample taken one conversion apart
+    struct AdcSample {
+        int16_t ref;
+        int16_t out;
+    };
+
+    class AdcStream {
+    private:
+        AdcSample samples[ADC_STREAM_SIZE]; //  The ring buffer, written by the interrupt and read by the sensor
+        volatile uint8_t head;      //  Where the interrupt writes the next pair, only changed by the interrupt
+        volatile uint8_t tail;      //  Where the next pair is read from, only changed outside the interrupt
+        volatile unsigned long overflows;   //  The number of pairs dropped because the buffer was full
+        volatile bool running;      //  Whether the ADC is free running
+
+        uint8_t refChannel;         //  The ADC channels being alternated between
+        uint8_t outChannel;
+        uint8_t converting;         //  The channel of the conversion the next interrupt reads
+        uint8_t queued;             //  The channel of the conversion that starts after it
+        int16_t lastRef;            //  The last reference sample, waiting to be paired with an output sample
+
+        void startConversions();
+        void stopConversions();
+    public:
+        AdcStream();
+        ~AdcStream();
+        bool start(uint8_t refPin, uint8_t outPin);
+        void stop();
+        bool isRunning();
+        bool pause();
+        void resume();
+        bool read(AdcSample& sample);
+        int analogRead(uint8_t pin);
+        unsigned long getOverflows();
+        void convert();
+    };
+
+    AdcStream::AdcStream() {
+        head = 0;
+        tail = 0;
+        overflows = 0;
+        running = false;
+    }
+
+    AdcStream::~AdcStream() {
+        //  Don't need to do anything when the object is destroyed
+    }
+
+    bool AdcStream::start(uint8_t refPin, uint8_t outPin) {
+        //  Starts streaming samples from the two pins, returns false if the board can't free run its ADC
+#ifdef ADC_STREAM_AVAILABLE
+        CHECK(!running, ERR_ADC_STREAM_RUNNING)
+#ifdef A0
+        //  Allow pins to be passed in as either A0 or 0, like analogRead does
+        if (refPin >= A0) refPin -= A0;
+        if (outPin >= A0) outPin -= A0;
+#endif
+        refChannel = refPin;
+        outChannel = outPin;
+        head = 0;
+        tail = 0;
+        startConversions();
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void AdcStream::stop() {
+        //  Stops the ADC free running, samples already in the buffer can still be read
+        stopConversions();
+    }
+
+    bool AdcStream::isRunning() {
+        return running;
+    }
+
+    void AdcStream::startConversions() {
+#ifdef ADC_STREAM_AVAILABLE
+        //  The first conversion reads the reference pin, and the output pin is selected for the second
+        //  once the first has locked its channel in, after that the interrupt keeps them alternating
+        converting = refChannel;
+        queued = outChannel;
+        ADMUX = _BV(REFS0) | refChannel;    //  AVcc reference, the same as analogRead's default
+        ADCSRB = 0;                         //  Auto trigger source is free running
+        running = true;
+        //  Enable the ADC in auto trigger mode with the conversion complete interrupt,
+        //  with a prescaler of 128 to give the full 10 bits of accuracy (about 9600 conversions a second)
+        ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+        delayMicroseconds(ADC_STREAM_MUX_HOLD_US);
+        ADMUX = _BV(REFS0) | outChannel;
+#endif
+    }
+
+    void AdcStream::stopConversions() {
+#ifdef ADC_STREAM_AVAILABLE
+        if (!running) return;
+        //  Turn off auto triggering and the interrupt, then let the conversion in progress finish
+        ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+        while (ADCSRA & _BV(ADSC)) {}
+        ADCSRA |= _BV(ADIF);    //  Clear the flag left by the last conversion
+        running = false;
+#endif
+    }
+
+    bool AdcStream::read(AdcSample& sample) {
+        //  Takes the oldest pair out of the buffer, returns false if the buffer is empty
+        uint8_t index = tail;
+        if (index == head) return false;
+        sample = samples[index];
+        tail = (index + 1) & (ADC_STREAM_SIZE - 1);
+        RECORD_INPUT(RECORD_ANALOG, refChannel, sample.ref);
+        RECORD_INPUT(RECORD_ANALOG, outChannel, sample.out);
+        return true;
+    }
+
+    bool AdcStream::pause() {
+        //  Stops the ADC free running so it can be used for other readings,
+        //  returns whether it was running and so needs resuming afterwards
+        if (!running) return false;
+        stopConversions();
+        return true;
+    }
+
+    void AdcStream::resume() {
+        //  Starts the ADC free running again after a pause
+        startConversions();
+    }
+
+    int AdcStream::analogRead(uint8_t pin) {
+        //  analogRead would wait forever for a free running ADC, so the stream is paused around it
+        bool paused = pause();
+        int reading = ::analogRead(pin);
+        if (paused) resume();
+#ifdef A0
+        RECORD_INPUT(RECORD_ANALOG, pin >= A0 ? pin - A0 : pin, reading);
+#else
+        RECORD_INPUT(RECORD_ANALOG, pin, reading);
+#endif
+        return reading;
+    }
+
+    unsigned long AdcStream::getOverflows() {
+        return overflows;
+    }
+
+    void AdcStream::convert() {
+        //  Called from the conversion complete interrupt
+#ifdef ADC_STREAM_AVAILABLE
+        //  Conversions made while the stream is stopped are read by whatever started them, e.g. a scan asleep
+        if (!running) return;
+        int16_t reading = ADC;
+        uint8_t channel = converting;
+
+        //  The next conversion has already started, so the channel set now is for the one after it
+        //  Setting it to the channel just read keeps the two pins alternating
+        converting = queued;
+        queued = channel;
+        ADMUX = _BV(REFS0) | channel;
+
+        if (channel == refChannel) {
+            lastRef = reading;
+            return;
+        }
+
+        //  Queue the output sample with the reference taken just before it
+        uint8_t index = head;
+        uint8_t next = (index + 1) & (ADC_STREAM_SIZE - 1);
+        if (next == tail) {
+            overflows++;
+            return;
+        }
+        samples[index].ref = lastRef;
+        samples[index].out = reading;
+        head = next;
+#endif
+    }
+
+    //  There is only one ADC, so there is only one stream
+    AdcStream adcStream;
+}
+
+#ifdef ADC_STREAM_AVAILABLE
+//  The conversion complete interrupt passes each sample to the stream
+ISR(ADC_vect) {
+    Sensor::adcStream.convert();
+}
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+// Reads a voltage from an ADS1115 16 bit ADC over I2C, as an async sensor
+// A conversion is started on each report and collected once it is done, so the sensor manager
+// keeps ticking the other sensors for the up to 125 milliseconds a conversion takes
+//
+// Usage:
+//     Ads1115Sensor current(ADS1115_DIFF_0_1, ADS1115_GAIN_2V, ADS1115_RATE_128);
+//     current.setup();
+//     current.setReportRate(20);
+//     manager.addSensor(&current);
+
+//  A header guard prevents the file from being included twice
+#ifndef ADS1115_H
+#define ADS1115_H
+#ifndef ARDUINO
+#error "The ADS1115 sensor needs the Wire library, it can only be built for the board"
+#endif
+#include "sensor.hpp"//  Include the parent sensor
+#include <Wire.h>//  Include the I2C library
+
+//  The address with the ADDR pin to ground
+#define ADS1115_ADDRESS 0x48
+
+//  The registers
+#define ADS1115_CONVERSION 0x00
+#define ADS1115_CONFIG 0x01
+
+//  Config register bits, a single conversion with the comparator turned off
+#define ADS1115_START 0x8000    //  Starts a conversion when written, reads as 1 once it is done
+#define ADS1115_SINGLE_SHOT 0x0100
+#define ADS1115_COMPARATOR_OFF 0x0003
+
+namespace Sensor {
+    //  The inputs that can be measured, differential pairs or one input against ground
+    enum Ads1115Input {
+        ADS1115_DIFF_0_1,
+        ADS1115_DIFF_0_3,
+        ADS1115_DIFF_1_3,
+        ADS1115_DIFF_2_3,
+        ADS1115_SINGLE_0,
+        ADS1115_SINGLE_1,
+        ADS1115_SINGLE_2,
+        ADS1115_SINGLE_3
+    };
+
+    //  The full scale ranges, +- this many volts
+    enum Ads1115Gain {
+        ADS1115_GAIN_6V,    //  6.144V
+        ADS1115_GAIN_4V,    //  4.096V
+        ADS1115_GAIN_2V,    //  2.048V
+        ADS1115_GAIN_1V,    //  1.024V
+        ADS1115_GAIN_HALF_V,    //  0.512V
+        ADS1115_GAIN_QUARTER_V  //  0.256V
+    };
+
+    //  The conversion rates, in samples per second
+    enum Ads1115Rate {
+        ADS1115_RATE_8,
+        ADS1115_RATE_16,
+        ADS1115_RATE_32,
+        ADS1115_RATE_64,
+        ADS1115_RATE_128,
+        ADS1115_RATE_250,
+        ADS1115_RATE_475,
+        ADS1115_RATE_860
+    };
+
+    class Ads1115Sensor : public AsyncSensor {
+    private:
+        uint8_t address;    //  The I2C address
+        uint16_t config;    //  The config register value that starts a conversion
+        double voltsPerCode;    //  The full scale range divided by the codes
+        unsigned int conversionTime;    //  How long a conversion takes at the rate, in milliseconds
+
+        bool writeRegister(uint8_t reg, uint16_t value);
+        bool readRegister(uint8_t reg, uint16_t& value);
+    public:
+        Ads1115Sensor(uint8_t input, uint8_t gain = ADS1115_GAIN_4V, uint8_t rate = ADS1115_RATE_128, uint8_t i2cAddress = ADS1115_ADDRESS);
+        ~Ads1115Sensor();
+        void setup();       //  Starts the I2C bus
+        void tick();
+        bool start();       //  All called by the sensor manager
+        bool poll();
+        double collect();
+        unsigned int getConversionTime();
+    };
+
+    Ads1115Sensor::Ads1115Sensor(uint8_t input, uint8_t gain, uint8_t rate, uint8_t i2cAddress) {
+        address = i2cAddress;
+        config = ADS1115_START | ((uint16_t)input << 12) | ((uint16_t)gain << 9) | ADS1115_SINGLE_SHOT
+            | ((uint16_t)rate << 5) | ADS1115_COMPARATOR_OFF;
+        const double fullScale[] = {6.144, 4.096, 2.048, 1.024, 0.512, 0.256};
+        voltsPerCode = fullScale[gain < 6 ? gain : 5] / 32768.0;
+        const int samplesPerSecond[] = {8, 16, 32, 64, 128, 250, 475, 860};
+        conversionTime = 1000 / samplesPerSecond[rate & 7] + 1;
+    }
+
+    Ads1115Sensor::~Ads1115Sensor() {
+        //  Don't need to do anything when the object is destroyed
+    }
+
+    void Ads1115Sensor::setup() {
+        Wire.begin();
+    }
+
+    void Ads1115Sensor::tick() {
+        //  Don't need to do anything for ticks, the ADC does its own averaging over the conversion
+    }
+
+    bool Ads1115Sensor::writeRegister(uint8_t reg, uint16_t value) {
+        Wire.beginTransmission(address);
+        Wire.write(reg);
+        Wire.write((uint8_t)(value >> 8));
+        Wire.write((uint8_t)value);
+        return Wire.endTransmission() == 0;
+    }
+
+    bool Ads1115Sensor::readRegister(uint8_t reg, uint16_t& value) {
+        Wire.beginTransmission(address);
+        Wire.write(reg);
+        if (Wire.endTransmission() != 0) return false;
+        if (Wire.requestFrom(address, (uint8_t)2) != 2) return false;
+        value = (uint16_t)Wire.read() << 8;
+        value |= Wire.read();
+        return true;
+    }
+
+    bool Ads1115Sensor::start() {
+        //  Writing the config starts a single conversion, which the ADC runs on its own
+        return writeRegister(ADS1115_CONFIG, config);
+    }
+
+    bool Ads1115Sensor::poll() {
+        //  The start bit reads back as 1 once the conversion is done
+        uint16_t status;
+        return readRegister(ADS1115_CONFIG, status) && (status & ADS1115_START);
+    }
+
+    double Ads1115Sensor::collect() {
+        uint16_t code;
+        if (!readRegister(ADS1115_CONVERSION, code)) return NAN;
+        return (int16_t)code * voltsPerCode;
+    }
+
+    unsigned int Ads1115Sensor::getConversionTime() {
+        return conversionTime;
+    }
+}
+
+#endif
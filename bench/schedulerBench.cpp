@@ -0,0 +1,203 @@
+// Scheduler benchmark, runs the sensor manager on the host HAL with synthetic sensors
+// and measures how well it keeps to their deadlines as the number of sensors and their rates go up
+//
+// Every configuration of 2 to 64 sensors ticking and reporting every 1 millisecond to 1 second
+// is run for the same stretch of virtual time, and one CSV row is printed for each:
+//     sensors, rate_ms, tick_cost_us, report_cost_us   the configuration
+//     requested_hz            the rate each sensor asked for, ticks and reports together
+//     achieved_hz_min/mean    the rate the slowest sensor and the average sensor got
+//     late_p50/p90/p99/max_us how late ticks and reports ran, over every sensor
+//     missed                  deadlines skipped because they were a whole period late
+//     busy                    the fraction of virtual time spent processing events
+//     overhead_ns_per_event   host time spin takes per event, the cost of the scheduler itself
+//                             since the synthetic sensors only move the virtual clock
+// With -p a row per sensor is printed after each configuration as well, with sensor set to its index
+//
+// Build and run from the repository root:
+//     g++ -std=gnu++11 -O2 -I. bench/schedulerBench.cpp -o schedulerBench
+// or with the rest of the host build, cmake -S . -B build && cmake --build build
+//     ./schedulerBench [-t tick cost us] [-r report cost us] [-d duration ms] [-p] > results.csv
+
+#define SENSOR_STATS
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include "sensorManager.hpp"
+
+//  The sweep, every sensor count is run at every rate
+const int SENSOR_COUNTS[] = {2, 4, 8, 16, 32, 64};
+const int RATES[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+//  How often the manager calls back, the same as the car's nodes
+#define BENCH_CALLBACK_RATE 100
+
+//  A sensor that does nothing but take a set time for each tick and report,
+//  and records how late it was called
+class SyntheticSensor : public Sensor::Sensor {
+private:
+    unsigned int tickCost;      //  How long tick and report take, in microseconds
+    unsigned int reportCost;
+    uint32_t nextTick;     //  The deadlines the scheduler should be calling at, in milliseconds
+    uint32_t nextReport;
+    void record(uint32_t& deadline, int period);
+public:
+    std::vector<unsigned long> lateness;    //  How late each tick and report was, in microseconds
+    unsigned long calls;        //  The number of ticks and reports
+
+    SyntheticSensor(unsigned int tickTime, unsigned int reportTime);
+    void start(uint32_t now);
+    void tick();
+    double report();
+};
+
+SyntheticSensor::SyntheticSensor(unsigned int tickTime, unsigned int reportTime) {
+    tickCost = tickTime;
+    reportCost = reportTime;
+    nextTick = 0;
+    nextReport = 0;
+    calls = 0;
+}
+
+void SyntheticSensor::start(uint32_t now) {
+    //  Must be called with the same time the sensor is added to the manager at
+    nextTick = now + getTickRate();
+    nextReport = now + getReportRate();
+}
+
+void SyntheticSensor::record(uint32_t& deadline, int period) {
+    //  Follows the scheduler's deadlines, skipping the same missed periods it does
+    uint32_t now = micros();
+    lateness.push_back(now - deadline * 1000);
+    uint32_t skipped;
+    deadline = ::Sensor::advanceDeadline(deadline, period, now / 1000, skipped);
+    calls++;
+}
+
+void SyntheticSensor::tick() {
+    record(nextTick, getTickRate());
+    delayMicroseconds(tickCost);
+}
+
+double SyntheticSensor::report() {
+    record(nextReport, getReportRate());
+    delayMicroseconds(reportCost);
+    return 0;   //  Kept below the diagnostic button threshold, so the manager stays out of diagnostic mode
+}
+
+void ignoreReadings(double*) {}
+
+unsigned long percentile(std::vector<unsigned long>& values, int percent) {
+    //  The value below which the percentage of the values fall, the values must be sorted
+    if (values.empty()) return 0;
+    size_t index = (values.size() - 1) * percent / 100;
+    return values[index];
+}
+
+double hostNanoseconds() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+void runConfiguration(int sensorCount, int rate, unsigned int tickCost, unsigned int reportCost,
+                      unsigned long duration, bool perSensor) {
+    hostHal.reset();
+    std::vector<SyntheticSensor> sensors;
+    sensors.reserve(sensorCount);   //  The manager keeps pointers to the sensors, so they can't move
+    //  At least as many slots as the car's sensors, which the manager's diagnostic checks look at
+    Sensor::SensorManager manager(std::max(sensorCount, 5), BENCH_CALLBACK_RATE);
+    manager.setReportCallback(ignoreReadings);
+    for (int i = 0; i < sensorCount; i++) {
+        sensors.push_back(SyntheticSensor(tickCost, reportCost));
+        SyntheticSensor& sensor = sensors.back();
+        sensor.setTickRate(rate);
+        sensor.setReportRate(rate);
+        sensor.start(millis());
+        manager.addSensor(&sensor);
+    }
+
+    //  Run for long enough to call the slowest sensors a good number of times
+    unsigned long runTime = duration;
+    if (runTime < (unsigned long)rate * 20) runTime = (unsigned long)rate * 20;
+    manager.resetStats();
+    double hostStart = hostNanoseconds();
+    manager.spin(runTime);
+    double hostTime = hostNanoseconds() - hostStart;
+
+    std::vector<unsigned long> lateness;
+    unsigned long events = runTime / BENCH_CALLBACK_RATE;
+    unsigned long missed = 0;
+    double minAchieved = 0;
+    double totalAchieved = 0;
+    for (int i = 0; i < sensorCount; i++) {
+        SyntheticSensor& sensor = sensors[i];
+        double achieved = sensor.calls * 1000.0 / runTime;
+        if (i == 0 || achieved < minAchieved) minAchieved = achieved;
+        totalAchieved += achieved;
+        lateness.insert(lateness.end(), sensor.lateness.begin(), sensor.lateness.end());
+        events += sensor.calls;
+        missed += manager.getStats(i).missed;
+    }
+    std::sort(lateness.begin(), lateness.end());
+
+    double requested = 2000.0 / rate;
+    printf("%d,%d,%u,%u,all,%.3f,%.3f,%.3f,%lu,%lu,%lu,%lu,%lu,%.4f,%.1f\n",
+           sensorCount, rate, tickCost, reportCost, requested, minAchieved, totalAchieved / sensorCount,
+           percentile(lateness, 50), percentile(lateness, 90), percentile(lateness, 99),
+           lateness.empty() ? 0 : lateness.back(), missed, manager.getBusyRatio(),
+           events > 0 ? hostTime / events : 0);
+
+    if (perSensor) {
+        for (int i = 0; i < sensorCount; i++) {
+            SyntheticSensor& sensor = sensors[i];
+            std::sort(sensor.lateness.begin(), sensor.lateness.end());
+            double achieved = sensor.calls * 1000.0 / runTime;
+            printf("%d,%d,%u,%u,%d,%.3f,%.3f,%.3f,%lu,%lu,%lu,%lu,%lu,,\n",
+                   sensorCount, rate, tickCost, reportCost, i, requested, achieved, achieved,
+                   percentile(sensor.lateness, 50), percentile(sensor.lateness, 90),
+                   percentile(sensor.lateness, 99), sensor.lateness.empty() ? 0 : sensor.lateness.back(),
+                   manager.getStats(i).missed);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned int tickCost = 20;
+    unsigned int reportCost = 100;
+    unsigned long duration = 10000;
+    bool perSensor = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tickCost = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            reportCost = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            duration = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            perSensor = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-t tick cost us] [-r report cost us] [-d duration ms] [-p]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("sensors,rate_ms,tick_cost_us,report_cost_us,sensor,requested_hz,achieved_hz_min,achieved_hz_mean,"
+           "late_p50_us,late_p90_us,late_p99_us,late_max_us,missed,busy,overhead_ns_per_event\n");
+    for (int sensorCount : SENSOR_COUNTS) {
+        for (int rate : RATES) {
+            runConfiguration(sensorCount, rate, tickCost, reportCost, duration, perSensor);
+        }
+    }
+
+    //  Any errors raised while running, such as too many events, would make the numbers meaningless
+    if (errorLog.getMessageCount() > 0) {
+        ErrorRecord record;
+        char message[96];
+        while (errorLog.pop(record)) {
+            errorLog.format(record, message, sizeof(message));
+            fprintf(stderr, "%s\n", message);
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Calibration turns ADC codes into engineering units with a lookup table, for sensors that aren't linear
+// The table is built at compile time from calibration points, joined with straight lines,
+// and kept in program memory, so a conversion is one table read and no floating point maths
+//
+// Usage:
+//     struct ThermistorCurve : CalibrationCurve {
+//         static constexpr int count = 3;
+//         static constexpr CalibrationPoint points[count] = {{150, 120.0}, {480, 45.0}, {890, 5.0}};
+//     };
+//     constexpr CalibrationPoint ThermistorCurve::points[];
+//     CalibrationTable<ThermistorCurve> thermistor;
+//     sensor.setCalibration(&thermistor);
+
+//  A header guard prevents the file from being included twice
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+#include "check.hpp"
+#include "fixed.hpp"
+
+//  The number of codes in a table, one for each code of the 10 bit ADC
+#define CALIBRATION_TABLE_SIZE 1024
+
+//  The table is built by doubling a list of codes, this many times gets to the table size
+#define CALIBRATION_TABLE_DOUBLINGS 10
+
+namespace Sensor {
+    //  A measured point on a calibration curve, the points must be in order of code
+    struct CalibrationPoint {
+        double code;    //  The ADC code, which doesn't have to be whole
+        double value;   //  The value in engineering units at that code
+    };
+
+    //  The defaults for a calibration curve, curves inherit from this and declare their own
+    //  count and points, and can replace the defaults
+    struct CalibrationCurve {
+        static constexpr int firstCode = 0;     //  The code of the first entry, negative for differential readings
+        static constexpr int fractionBits = 6;  //  The bits of fraction each entry keeps, values must fit +-2^(15 - fractionBits)
+    };
+
+    //  What a sensor sees of a calibration, so any table can be given to any sensor
+    class Calibration {
+    public:
+        virtual Fixed convert(Fixed code) = 0;  //  Converts a code, which can be a fraction, e.g. from a filter
+        Fixed convert(int code);
+    };
+
+    Fixed Calibration::convert(int code) {
+        return convert(Fixed(code));
+    }
+
+    //  Finds the segment of the curve a code is on, the first or last segment if it is off the end
+    template <class Curve>
+    constexpr int calibrationSegment(double code, int segment) {
+        return segment + 2 >= Curve::count || code < Curve::points[segment + 1].code
+            ? segment : calibrationSegment<Curve>(code, segment + 1);
+    }
+
+    //  Works out the value at a code along a segment of the curve
+    template <class Curve>
+    constexpr double calibrationInterpolate(double code, int segment) {
+        return Curve::points[segment].value + (Curve::points[segment + 1].value - Curve::points[segment].value)
+            * (code - Curve::points[segment].code) / (Curve::points[segment + 1].code - Curve::points[segment].code);
+    }
+
+    //  Rounds a scaled value to the nearest table entry, clamping it into range
+    constexpr int16_t calibrationRound(double scaled) {
+        return scaled >= 32767.0 ? 32767 : scaled <= -32768.0 ? -32768
+            : (int16_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+    }
+
+    //  The table entry for the code at an index
+    template <class Curve>
+    constexpr int16_t calibrationEntry(int index) {
+        return calibrationRound(calibrationInterpolate<Curve>(index + Curve::firstCode,
+            calibrationSegment<Curve>(index + Curve::firstCode, 0)) * (double)(1L << Curve::fractionBits));
+    }
+
+    //  A list of the table indexes, doubled a level at a time
+    //  so making 1024 of them doesn't need 1024 levels of templates
+    template <int... Indexes>
+    struct CalibrationIndexes {
+        typedef CalibrationIndexes<Indexes..., (Indexes + sizeof...(Indexes))...> doubled;
+    };
+
+    template <int Doublings>
+    struct CalibrationRange {
+        typedef typename CalibrationRange<Doublings - 1>::type::doubled type;
+    };
+
+    template <>
+    struct CalibrationRange<0> {
+        typedef CalibrationIndexes<0> type;
+    };
+
+    //  The table itself, one entry per index
+    template <class Curve, class Indexes>
+    struct CalibrationData;
+
+    template <class Curve, int... Indexes>
+    struct CalibrationData<Curve, CalibrationIndexes<Indexes...>> {
+        static const int16_t table[sizeof...(Indexes)];
+    };
+
+    template <class Curve, int... Indexes>
+    const int16_t CalibrationData<Curve, CalibrationIndexes<Indexes...>>::table[sizeof...(Indexes)] PROGMEM = {
+        calibrationEntry<Curve>(Indexes)...
+    };
+
+    template <class Curve>
+    class CalibrationTable : public Calibration {
+        static_assert(Curve::count >= 2, "A calibration curve needs at least 2 points");
+        static_assert(Curve::fractionBits >= 0 && Curve::fractionBits <= 16, "Calibration entries can keep at most 16 bits of fraction");
+        typedef CalibrationData<Curve, typename CalibrationRange<CALIBRATION_TABLE_DOUBLINGS>::type> Data;
+
+        int16_t entry(int index);
+        Fixed toFixed(int32_t value, int bits);
+    public:
+        using Calibration::convert;
+        Fixed convert(Fixed code);
+    };
+
+    template <class Curve>
+    int16_t CalibrationTable<Curve>::entry(int index) {
+#ifdef pgm_read_word
+        return (int16_t)pgm_read_word(&Data::table[index]);
+#else
+        return Data::table[index];
+#endif
+    }
+
+    template <class Curve>
+    Fixed CalibrationTable<Curve>::toFixed(int32_t value, int bits) {
+        //  Turns a number with some bits of fraction into a Fixed
+        if (bits <= 16) return Fixed::fromRaw(value * ((int32_t)1 << (16 - bits)));
+        return Fixed::fromRaw(value >> (bits - 16));
+    }
+
+    template <class Curve>
+    Fixed CalibrationTable<Curve>::convert(Fixed code) {
+        //  Looks up the codes either side and moves between them by the fraction of the code
+        int32_t position = code.raw() - (int32_t)Curve::firstCode * 65536;
+        if (position <= 0) {
+            return toFixed(entry(0), Curve::fractionBits);
+        }
+        if (position >= ((int32_t)(CALIBRATION_TABLE_SIZE - 1) << 16)) {
+            return toFixed(entry(CALIBRATION_TABLE_SIZE - 1), Curve::fractionBits);
+        }
+        int index = position >> 16;
+        int32_t low = entry(index);
+        int32_t high = entry(index + 1);
+        //  8 bits of the fraction is plenty between neighbouring codes, and keeps the product in 32 bits
+        int32_t fraction = (position & 0xFFFF) >> 8;
+        return toFixed(low * 256 + (high - low) * fraction, Curve::fractionBits + 8);
+    }
+}
+
+#endif
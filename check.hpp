@@ -2,74 +2,272 @@
 //  A header guard prevents the file from being included twice
 #ifndef CHECK_H
 #define CHECK_H
+#include "hal.hpp"
+
+//  The max number of errors the log holds, any more are counted but not stored
+#define ERROR_LOG_SIZE 8
+
+//  The errors that can be raised, the text for each is in errorText
+enum ErrorCode {
+    ERR_TICK_RATE_TOO_LOW,
+    ERR_TICK_RATE_ALREADY_SET,
+    ERR_REPORT_RATE_TOO_LOW,
+    ERR_REPORT_RATE_ALREADY_SET,
+    ERR_CALLBACK_ALREADY_SET,
+    ERR_TOO_MANY_SENSORS,
+    ERR_SENSOR_NOT_FOUND,
+    ERR_TOO_MANY_EVENTS,
+    ERR_INDICATOR_OUT_OF_RANGE,
+    ERR_ADC_STREAM_RUNNING,
+    ERR_TOO_MANY_CHANNELS,
+    ERR_RTC_INIT_FAILED,
+    ERR_TELEMETRY_CHANNEL_OUT_OF_RANGE,
+    ERR_TELEMETRY_BUFFER_TOO_SMALL,
+    ERR_CHANNEL_OUT_OF_RANGE,
+    ERR_SUBSCRIPTION_RATE_TOO_LOW,
+    ERR_TOO_MANY_SUBSCRIBERS,
+    ERR_SUBSCRIBER_NOT_FOUND,
+    ERR_READING_OUT_OF_RANGE,
+    ERR_ASYNC_TIMEOUT,
+    ERR_ADAPTIVE_RATE_INVALID,
+    ERR_TOO_MANY_VALUES
+};
+
+//  Looks up the text for an error, the text is kept in program memory until it is needed
+const char* errorText(uint8_t code) {
+    switch (code) {
+        case ERR_TICK_RATE_TOO_LOW: return PSTR("Tick rate must be at least 1 millisecond");
+        case ERR_TICK_RATE_ALREADY_SET: return PSTR("Tick rate already set");
+        case ERR_REPORT_RATE_TOO_LOW: return PSTR("Read rate must be at least 1 millisecond");
+        case ERR_REPORT_RATE_ALREADY_SET: return PSTR("Read rate already set");
+        case ERR_CALLBACK_ALREADY_SET: return PSTR("Report callback already set");
+        case ERR_TOO_MANY_SENSORS: return PSTR("Too many sensors added");
+        case ERR_SENSOR_NOT_FOUND: return PSTR("Sensor not found.");
+        case ERR_TOO_MANY_EVENTS: return PSTR("Too many scheduled events");
+        case ERR_INDICATOR_OUT_OF_RANGE: return PSTR("Indicator channel out of range");
+        case ERR_ADC_STREAM_RUNNING: return PSTR("ADC stream already running");
+        case ERR_TOO_MANY_CHANNELS: return PSTR("Too many acquisition channels");
+        case ERR_RTC_INIT_FAILED: return PSTR("RTC initialization failed");
+        case ERR_TELEMETRY_CHANNEL_OUT_OF_RANGE: return PSTR("Telemetry channel out of range");
+        case ERR_TELEMETRY_BUFFER_TOO_SMALL: return PSTR("Telemetry buffer too small for frame");
+        case ERR_CHANNEL_OUT_OF_RANGE: return PSTR("Only the first 32 sensors can report on change");
+        case ERR_SUBSCRIPTION_RATE_TOO_LOW: return PSTR("Subscription rate must be at least 1 millisecond");
+        case ERR_TOO_MANY_SUBSCRIBERS: return PSTR("Too many subscribers");
+        case ERR_SUBSCRIBER_NOT_FOUND: return PSTR("Subscriber not found");
+        case ERR_READING_OUT_OF_RANGE: return PSTR("Reading index out of range");
+        case ERR_ASYNC_TIMEOUT: return PSTR("Sensor reading didn't finish in time");
+        case ERR_ADAPTIVE_RATE_INVALID: return PSTR("Adaptive rates need a report rate, and fastest from 1 to slowest");
+        case ERR_TOO_MANY_VALUES: return PSTR("Too many sensor values for the readings");
+        default: return PSTR("Unknown error");
+    }
+}
+
+//  The files errors can be raised in, so a record keeps a byte rather than the file's whole path,
+//  which the compiler gives as an absolute path and would store in program memory for every error
+//  Errors raised anywhere else, e.g. in the sketch, are from ERR_FILE_OTHER
+enum ErrorFile {
+    ERR_FILE_OTHER,
+    ERR_FILE_ACQUISITION,
+    ERR_FILE_ADC_STREAM,
+    ERR_FILE_CLOCK,
+    ERR_FILE_INDICATOR,
+    ERR_FILE_SCHEDULER,
+    ERR_FILE_SENSOR,
+    ERR_FILE_SENSOR_MANAGER,
+    ERR_FILE_SNAPSHOT,
+    ERR_FILE_STATIC_SENSOR_MANAGER,
+    ERR_FILE_TELEMETRY
+};
+
+//  Whether two names are the same, at compile time
+constexpr bool errorSameName(const char* a, const char* b) {
+    return *a == *b && (*a == '\0' || errorSameName(a + 1, b + 1));
+}
+
+//  The part of a path after the last slash, at compile time
+constexpr const char* errorBaseName(const char* path, const char* base) {
+    return *path == '\0' ? base : errorBaseName(path + 1, *path == '/' || *path == '\\' ? path + 1 : base);
+}
+
+//  Finds the file an error was raised in from its path, at compile time so the path isn't stored
+constexpr uint8_t errorFileId(const char* name) {
+    return errorSameName(name, "acquisition.hpp") ? ERR_FILE_ACQUISITION
+        : errorSameName(name, "adcStream.hpp") ? ERR_FILE_ADC_STREAM
+        : errorSameName(name, "clock.hpp") ? ERR_FILE_CLOCK
+        : errorSameName(name, "indicator.hpp") ? ERR_FILE_INDICATOR
+        : errorSameName(name, "scheduler.hpp") ? ERR_FILE_SCHEDULER
+        : errorSameName(name, "sensor.hpp") ? ERR_FILE_SENSOR
+        : errorSameName(name, "sensorManager.hpp") ? ERR_FILE_SENSOR_MANAGER
+        : errorSameName(name, "snapshot.hpp") ? ERR_FILE_SNAPSHOT
+        : errorSameName(name, "staticSensorManager.hpp") ? ERR_FILE_STATIC_SENSOR_MANAGER
+        : errorSameName(name, "telemetry.hpp") ? ERR_FILE_TELEMETRY
+        : ERR_FILE_OTHER;
+}
+
+//  Looks up the name of a file, kept in program memory until it is needed
+const char* errorFileName(uint8_t file) {
+    switch (file) {
+        case ERR_FILE_ACQUISITION: return PSTR("acquisition.hpp");
+        case ERR_FILE_ADC_STREAM: return PSTR("adcStream.hpp");
+        case ERR_FILE_CLOCK: return PSTR("clock.hpp");
+        case ERR_FILE_INDICATOR: return PSTR("indicator.hpp");
+        case ERR_FILE_SCHEDULER: return PSTR("scheduler.hpp");
+        case ERR_FILE_SENSOR: return PSTR("sensor.hpp");
+        case ERR_FILE_SENSOR_MANAGER: return PSTR("sensorManager.hpp");
+        case ERR_FILE_SNAPSHOT: return PSTR("snapshot.hpp");
+        case ERR_FILE_STATIC_SENSOR_MANAGER: return PSTR("staticSensorManager.hpp");
+        case ERR_FILE_TELEMETRY: return PSTR("telemetry.hpp");
+        default: return PSTR("sketch");
+    }
+}
+
+//  A compact record of an error, only turned into text when the log is handled
+struct ErrorRecord {
+    uint8_t code;       //  The error code
+    uint8_t file;       //  The file the error was raised in
+    uint16_t line;      //  The line the error was raised on
+    long arg;           //  An optional number to go with the error, 0 if there isn't one
+};
 
 //  The error log keeps track of errors produced by the sensors
+//  in a fixed size ring, so raising an error never allocates memory
 class ErrorLog {
 private:
-    int max;    //  The max number of error messages that can be produced
-    int messageCount;   //  The number of error messages produced
-    char** messages;    //  The error messages
+    ErrorRecord records[ERROR_LOG_SIZE];    //  The errors waiting to be handled
+    uint8_t first;      //  The position of the oldest error in the ring
+    uint8_t count;      //  The number of errors in the ring
+    unsigned long overflows;    //  The number of errors dropped because the ring was full
+    bool halting;       //  Whether handling the errors stops the program
 public:
-    ErrorLog(int maxMessages = 8);
+    ErrorLog();
     ~ErrorLog();
-    void raise(char* message);
+    void raise(uint8_t code, uint8_t file, int line, long arg);
     int getMessageCount();
-    char* getMessage(int i);
+    unsigned long getOverflows();
+    void clearOverflows();
+    bool pop(ErrorRecord& record);
+    void format(const ErrorRecord& record, char* message, int size);
+    void setHalting(bool halt);
+    bool isHalting();
 };
 
-ErrorLog::ErrorLog(int maxMessages = 8) {
-    max = maxMessages;
-    messages = (char**)malloc(max * sizeof(char*)); //  Initialises an array to store the messages
-    messageCount = 0; //  No messages have been produced to begin with
+ErrorLog::ErrorLog() {
+    first = 0;
+    count = 0;  //  No errors have been produced to begin with
+    overflows = 0;
+    halting = true;
 }
 ErrorLog::~ErrorLog() {
 }
 
-void ErrorLog::raise(char* message) {
-    //  When an error message is produced
-    int len = strlen(message); //  Initialise memory to store the message
-    char* m = (char*)malloc((len + 1) * sizeof(char)); //  Initialise memory to store the message
-    strcpy(m, message); //  Copy the message into memory
-    messages[messageCount] = m; //  Store the message in the array of messages
-    messageCount++; //  Add one to the message count
+void ErrorLog::raise(uint8_t code, uint8_t file, int line, long arg) {
+    //  When an error is produced, store it at the end of the ring
+    //  If the ring is full the first errors are kept, as later ones are often caused by them
+    if (count >= ERROR_LOG_SIZE) {
+        overflows++;
+        return;
+    }
+    ErrorRecord& record = records[(first + count) % ERROR_LOG_SIZE];
+    record.code = code;
+    record.file = file;
+    record.line = line;
+    record.arg = arg;
+    count++; //  Add one to the error count
 }
 
 int ErrorLog::getMessageCount() {
-    return messageCount;
+    return count;
+}
+
+unsigned long ErrorLog::getOverflows() {
+    return overflows;
 }
 
-char* ErrorLog::getMessage(int i) {
-    return messages[i];
+void ErrorLog::clearOverflows() {
+    overflows = 0;
+}
+
+bool ErrorLog::pop(ErrorRecord& record) {
+    //  Takes the oldest error out of the ring, returns false if there are none
+    if (count == 0) return false;
+    record = records[first];
+    first = (first + 1) % ERROR_LOG_SIZE;
+    count--;
+    return true;
+}
+
+void ErrorLog::format(const ErrorRecord& record, char* message, int size) {
+    //  Turns an error into text, the file and error text are copied out of program memory first
+    char file[24];
+    char text[48];
+    strncpy_P(file, errorFileName(record.file), sizeof(file) - 1);
+    file[sizeof(file) - 1] = '\0';
+    strncpy_P(text, errorText(record.code), sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    if (record.arg != 0) {
+        snprintf(message, size, "Error at %s line %u: %s (%ld)", file, record.line, text, record.arg);
+    } else {
+        snprintf(message, size, "Error at %s line %u: %s", file, record.line, text);
+    }
+}
+
+void ErrorLog::setHalting(bool halt) {
+    //  When not halting, the program carries on once the errors have been handled
+    //  so a fault in one sensor doesn't stop the others
+    halting = halt;
+}
+
+bool ErrorLog::isHalting() {
+    return halting;
 }
 
 ErrorLog errorLog;
 
 //  Shorthand for checking if a condition is met, and raising an error if it isn't
-#define CHECK(cond, message)    \
+#define CHECK(cond, code)       \
     {                           \
         if (!(cond)) {          \
-            RAISE(message);     \
+            RAISE(code);        \
         }                       \
     }
 
+//  Shorthand for checking a condition and raising an error with a number to go with it
+#define CHECK_ARG(cond, code, arg)  \
+    {                               \
+        if (!(cond)) {              \
+            RAISE_ARG(code, arg);   \
+        }                           \
+    }
+
 //  Shorthand for raising an error and passing it to the log
-#define RAISE(message)                                                      \
-    {                                                                       \
-        char m[128];                                                        \
-        sprintf(m, "Error at %s line %d: %s\0", __FILE__, __LINE__, message); \
-        errorLog.raise(m);                                                  \
+#define RAISE(code) RAISE_ARG(code, 0)
+
+//  Shorthand for raising an error with a number to go with it
+//  The file is looked up at compile time, so only its number is stored
+#define RAISE_ARG(code, arg)                                                                \
+    {                                                                                       \
+        constexpr uint8_t errorFile = errorFileId(errorBaseName(__FILE__, __FILE__));       \
+        errorLog.raise(code, errorFile, __LINE__, arg);                                     \
     }
 
 //  Shorthand for reporting all the errors to an error handling function
-//  and stopping the program
-#define HANDLE_ERRS(handler)                                        \
-    {                                                               \
-        if (errorLog.getMessageCount() > 0) {                       \
-            for (int i = 0; i < errorLog.getMessageCount(); i++) {  \
-                char* message = errorLog.getMessage(i);             \
-                handler(message);                                   \
-            }                                                       \
-            while (true) {delay(1000);}                             \
-        }                                                           \
+//  and stopping the program, unless the error log has been set not to halt
+#define HANDLE_ERRS(handler)                                                    \
+    {                                                                           \
+        if (errorLog.getMessageCount() > 0 || errorLog.getOverflows() > 0) {    \
+            char message[96];                                                   \
+            ErrorRecord record;                                                 \
+            while (errorLog.pop(record)) {                                      \
+                errorLog.format(record, message, sizeof(message));              \
+                handler(message);                                               \
+            }                                                                   \
+            if (errorLog.getOverflows() > 0) {                                  \
+                snprintf(message, sizeof(message), "%lu more errors dropped",   \
+                         errorLog.getOverflows());                              \
+                handler(message);                                               \
+                errorLog.clearOverflows();                                      \
+            }                                                                   \
+            while (errorLog.isHalting()) {delay(1000);}                         \
+        }                                                                       \
     }
-#endif
\ No newline at end of file
+#endif
@@ -2,23 +2,56 @@
 #ifndef CLOCK_H
 #define CLOCK_H
 #include "sensor.hpp"//  Include the parent sensor
-#include "RTClib.h"//  Include the clock library
+#include "record.hpp"//  RTC reads can be recorded
+#ifdef ARDUINO
+#include "RTClib.h"//  Include the clock library, the host HAL has its own stand in
+#endif
+
+//  How often the clock is checked against the RTC by default, in milliseconds
+#define CLOCK_RESYNC_INTERVAL 60000
+
+//  How long setup waits for the RTC's seconds to tick over, so the sub-second part starts in phase
+#define CLOCK_SYNC_TIMEOUT 1100
+
+//  Resyncs wait until the clock is within this many milliseconds of a second starting,
+//  which is when reading the RTC says the most about whether the clock is ahead or behind
+//  Just before the second catches the clock running behind, and just after catches it running ahead
+#define CLOCK_SYNC_WINDOW 50
 
 namespace Sensor {
     class Clock : public Sensor {
     private:
         RTC_DS3231 rtc; //  The real time clock object
         DateTime start; //  The time the clock was turned on
+        uint32_t baseTime;          //  The RTC time (unixtime) at the start of a second the clock is counting from
+        uint32_t baseMillis;   //  The value of millis() at the start of that second
+        uint32_t startMillis;  //  The value of millis() when the clock was set up
+        uint32_t lastSync;     //  The value of millis() when the clock last agreed with the RTC
+        uint32_t resyncInterval;   //  How often to check against the RTC
+        uint8_t syncChecks;     //  Which sides of a second the clock has agreed with the RTC on since the last correction
+        long drift;     //  How far the millis() clock has got ahead of the RTC in total, in milliseconds
+
+        DateTime readRtc();
     public:
-        Clock();        //  Called when a new sensor object is created
+        Clock(uint32_t interval = CLOCK_RESYNC_INTERVAL);  //  Called when a new sensor object is created
         ~Clock();       //  Called when a sensor object is destroyed
         void setup();   //  Connects to the RTC chip and sets it up
         void tick();    //  Both called by the sensor manager
         double report();
+        uint8_t getDecimals(uint8_t value);
+        bool resync();  //  Checks the clock against the RTC and corrects it
+        void setResyncInterval(uint32_t interval);
+        void getTime(uint32_t& seconds, uint16_t& milliseconds);
+        long getDrift();
+        double getDriftPpm();
     };
 
-    Clock::Clock() {
-        //  Don't need to do anything when the object is created
+    Clock::Clock(uint32_t interval) {
+        resyncInterval = interval;
+        baseTime = 0;
+        baseMillis = 0;
+        drift = 0;
+        syncChecks = 0;
     }
 
     Clock::~Clock() {
@@ -28,8 +61,27 @@ namespace Sensor {
     void Clock::setup() {
         //  Connect to the RTC chip and check it initialized correctly
         bool rtcStatus = rtc.begin();
-        CHECK(rtcStatus == true, "RTC initialization failed");
-        start = rtc.now(); //  Set start time
+        CHECK(rtcStatus == true, ERR_RTC_INIT_FAILED);
+        start = readRtc(); //  Set start time
+
+        //  The RTC only counts whole seconds, so wait for the next one to start
+        //  to know where millis() is within the second
+        uint32_t waitStart = millis();
+        DateTime now = start;
+        while (now.unixtime() == start.unixtime() && millis() - waitStart < CLOCK_SYNC_TIMEOUT) {
+            now = readRtc();
+        }
+        baseTime = now.unixtime();
+        baseMillis = millis();
+        startMillis = baseMillis;
+        lastSync = baseMillis;
+    }
+
+    DateTime Clock::readRtc() {
+        //  Every RTC read comes through here, so it can be recorded
+        DateTime now = rtc.now();
+        RECORD_INPUT(RECORD_RTC, 0, now.unixtime());
+        return now;
     }
 
     void Clock::tick() {
@@ -38,12 +90,102 @@ namespace Sensor {
 
     double Clock::report() {
         //  Called by the sensor manager whenever the time should be reported
-        DateTime now = rtc.now();           //  Check current time
-        uint32_t unixNow = now.unixtime();  //  Calculate time since start
+        //  The time is worked out from millis(), and only checked against the RTC every resync interval
+        uint32_t unixNow;
+        uint16_t milliseconds;
+        getTime(unixNow, milliseconds);     //  Check current time
+        uint32_t sinceSync = millis() - lastSync;
+        if (sinceSync >= resyncInterval) {
+            //  Waits for a report close to the start of a second, unless that is taking too long
+            bool nearSecond = milliseconds < CLOCK_SYNC_WINDOW || milliseconds >= 1000 - CLOCK_SYNC_WINDOW;
+            if (nearSecond || sinceSync >= resyncInterval + 2 * CLOCK_SYNC_TIMEOUT) {
+                bool timedOut = sinceSync >= resyncInterval + 2 * CLOCK_SYNC_TIMEOUT;
+                bool agreed = resync();
+                if (!nearSecond) {
+                    //  A forced check only catches big errors, but checking again on every report wouldn't
+                    //  catch any more, so wait a whole interval for the next one
+                    syncChecks = 0;
+                    lastSync = millis();
+                } else if (!agreed) {
+                    syncChecks = 0;
+                } else {
+                    //  The clock agrees with the RTC once it has been checked on both sides of a second without correcting it
+                    //  Reports in phase with the seconds only ever land on one side, so after the timeout one side will do
+                    syncChecks |= milliseconds < CLOCK_SYNC_WINDOW ? 2 : 1;
+                    if (syncChecks == 3 || timedOut) {
+                        syncChecks = 0;
+                        lastSync = millis();
+                    }
+                }
+                getTime(unixNow, milliseconds);
+            }
+        }
         uint32_t relTime = 1704067200;      // unixtime of 01/01/2024 00:00:00
-        double relUnixNow = unixNow - relTime; // time in seconds relative to 01/01/2024 00:00:00
+        double relUnixNow = (unixNow - relTime) + milliseconds / 1000.0; // time in seconds relative to 01/01/2024 00:00:00
         return relUnixNow;
     }
+
+    uint8_t Clock::getDecimals(uint8_t value) {
+        //  The time in seconds since 2024 is too big for telemetry to keep milliseconds without clamping,
+        //  whole seconds fit until 2092
+        return 0;
+    }
+
+    bool Clock::resync() {
+        //  Reads the RTC and corrects the clock by as little as possible to agree with it
+        //  Within a second of agreeing, the RTC can't say anything more precise, so the clock is left alone
+        //  Returns true if the clock already agreed, if not the report keeps resyncing near each second
+        //  until it does, which walks the clock onto the RTC's second boundary
+        uint32_t now = millis();
+        uint32_t rtcTime = readRtc().unixtime();
+
+        //  Move whole seconds into the base time, so the millis() difference never gets big enough to wrap
+        uint32_t elapsed = now - baseMillis;
+        baseTime += elapsed / 1000;
+        baseMillis += (elapsed / 1000) * 1000;
+
+        //  How far the clock is ahead of the start of the RTC's current second
+        long ahead = (int32_t)(baseTime - rtcTime) * 1000 + (int32_t)(now - baseMillis);
+        long correction = 0;
+        if (ahead < 0) {
+            correction = ahead;         //  The clock is behind the RTC
+        } else if (ahead >= 1000) {
+            correction = ahead - 999;   //  The clock is ahead of the end of the RTC's second
+        }
+        baseMillis += correction;       //  Moving the base later takes time off the clock
+        drift += correction;
+
+        //  Keep the base at or before now, borrowing a second if the correction moved it past
+        while ((int32_t)(now - baseMillis) < 0) {
+            baseTime--;
+            baseMillis -= 1000;
+        }
+        return correction == 0;
+    }
+
+    void Clock::setResyncInterval(uint32_t interval) {
+        resyncInterval = interval;
+    }
+
+    void Clock::getTime(uint32_t& seconds, uint16_t& milliseconds) {
+        //  The current time as unixtime and milliseconds, without talking to the RTC
+        uint32_t elapsed = millis() - baseMillis;
+        seconds = baseTime + elapsed / 1000;
+        milliseconds = elapsed % 1000;
+    }
+
+    long Clock::getDrift() {
+        //  How many milliseconds the millis() clock has gained on the RTC since setup,
+        //  measured to within a second at each resync
+        return drift;
+    }
+
+    double Clock::getDriftPpm() {
+        //  The drift as a rate, in parts per million (positive if millis() runs fast)
+        uint32_t elapsed = lastSync - startMillis;
+        if (elapsed == 0) return 0;
+        return (double)drift * 1000000.0 / (double)elapsed;
+    }
 }
 
-#endif
\ No newline at end of file
+#endif
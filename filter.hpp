@@ -0,0 +1,282 @@
+// Filters smooth the raw samples a sensor takes on its ticks before they are reported
+// A filter is a pipeline of stages, each one integer only and a fixed size, e.g.
+//     FilterPipeline<MedianStage<3>, OversampleStage<16, 2>, EmaStage<3>> filter;
+//     sensor.attachFilter(&filter);
+// rejects single sample spikes, averages 16 samples into one with 2 extra bits, then smooths the result
+//
+// Stages that take several samples to make one (oversample and CIC) decimate, so the stages after them
+// run less often, and stages that add bits make the output a fraction of an ADC code
+
+//  A header guard prevents the file from being included twice
+#ifndef FILTER_H
+#define FILTER_H
+#include "check.hpp"
+#include "fixed.hpp"
+
+namespace Sensor {
+    //  log2 of a power of 2, worked out at compile time
+    constexpr int filterLog2(int number) {
+        return number <= 1 ? 0 : 1 + filterLog2(number / 2);
+    }
+
+    //  Averages every Count samples into one, keeping ExtraBits bits of the fraction
+    //  Each extra bit needs 4 times as many samples, and some noise on the input, to be real
+    template <int Count, int ExtraBits = 0>
+    struct OversampleStage {
+        static_assert(Count >= 1 && Count <= 1024, "Oversample count must be from 1 to 1024");
+        static_assert(ExtraBits >= 0 && ExtraBits <= 6, "Oversample can add at most 6 bits");
+        static constexpr int fractionBits = ExtraBits;
+
+        int32_t total;  //  The sum of the samples so far
+        int count;      //  The number of samples so far
+
+        OversampleStage() { reset(); }
+        void reset();
+        bool push(int32_t sample, int32_t& output);
+    };
+
+    //  Exponential moving average, each output moves 1/2^Shift of the way to the new sample
+    template <int Shift>
+    struct EmaStage {
+        static_assert(Shift >= 1 && Shift <= 8, "EMA shift must be from 1 to 8");
+        static constexpr int fractionBits = 0;
+
+        int32_t state;  //  The average multiplied by 2^Shift, so small steps aren't lost
+        bool primed;    //  Whether the average has started
+
+        EmaStage() { reset(); }
+        void reset();
+        bool push(int32_t sample, int32_t& output);
+    };
+
+    //  Running median of the last Size samples, which throws away spikes shorter than half the window
+    template <int Size>
+    struct MedianStage {
+        static_assert(Size >= 3 && Size <= 15 && Size % 2 == 1, "Median size must be odd, from 3 to 15");
+        static constexpr int fractionBits = 0;
+
+        int32_t history[Size];  //  The last samples, oldest overwritten first
+        int count;      //  The number of samples in the history
+        int position;   //  Where the next sample goes
+
+        MedianStage() { reset(); }
+        void reset();
+        bool push(int32_t sample, int32_t& output);
+    };
+
+    //  Cascaded integrator comb filter, a sharper decimating average than oversampling
+    //  for the same cost, Order integrators then Order combs at 1/Decimation of the rate
+    //  The first Order outputs are still settling
+    template <int Decimation, int Order, int ExtraBits = 0>
+    struct CicStage {
+        static_assert(Decimation >= 2 && (Decimation & (Decimation - 1)) == 0, "CIC decimation must be a power of 2");
+        static_assert(Order >= 1 && Order <= 4, "CIC order must be from 1 to 4");
+        static constexpr int growthBits = Order * filterLog2(Decimation);   //  The gain of the filter in bits
+        static_assert(growthBits <= 16, "CIC gain must fit in 16 bits above the sample");
+        static_assert(ExtraBits >= 0 && ExtraBits <= growthBits, "CIC can't add more bits than its gain");
+        static constexpr int fractionBits = ExtraBits;
+
+        //  Unsigned so the integrators wrap around, which the combs undo
+        uint32_t integrators[Order];
+        uint32_t combs[Order];  //  The last input to each comb
+        int phase;      //  The number of samples since the last output
+
+        CicStage() { reset(); }
+        void reset();
+        bool push(int32_t sample, int32_t& output);
+    };
+
+    //  Runs a sample through each stage in turn, one level of the list per stage,
+    //  stopping when a stage is still collecting samples
+    template <class... Stages>
+    struct FilterStages {
+        //  The end of the list passes the sample straight out
+        static constexpr int fractionBits = 0;
+        void reset() {}
+        bool push(int32_t sample, int32_t& output) { output = sample; return true; }
+    };
+
+    template <class First, class... Rest>
+    struct FilterStages<First, Rest...> {
+        static constexpr int fractionBits = First::fractionBits + FilterStages<Rest...>::fractionBits;
+
+        First first;
+        FilterStages<Rest...> rest;
+
+        void reset() {
+            first.reset();
+            rest.reset();
+        }
+
+        bool push(int32_t sample, int32_t& output) {
+            int32_t middle;
+            if (!first.push(sample, middle)) return false;
+            return rest.push(middle, output);
+        }
+    };
+
+    //  What a sensor sees of a filter, so any pipeline can be attached to any sensor
+    class Filter {
+    public:
+        virtual void reset() = 0;   //  Forgets every sample
+        virtual bool push(int32_t sample) = 0;  //  Adds a sample, returns true if there is a new output
+        virtual bool ready() = 0;   //  Whether there has been an output since the last reset
+        virtual int32_t value() = 0;    //  The last output, in 1/2^fractionBits of a sample
+        virtual uint8_t getFractionBits() = 0;
+        Fixed output();
+    };
+
+    Fixed Filter::output() {
+        //  The last output in whole samples, e.g. ADC codes, with the extra bits as the fraction
+        return Fixed::fromRaw(value() * ((int32_t)1 << (16 - getFractionBits())));
+    }
+
+    template <class... Stages>
+    class FilterPipeline : public Filter {
+        static_assert(FilterStages<Stages...>::fractionBits <= 16, "A filter can add at most 16 bits");
+    private:
+        FilterStages<Stages...> stages;
+        int32_t latest;     //  The last output
+        bool hasOutput;     //  Whether there has been an output since the last reset
+    public:
+        FilterPipeline();
+        void reset();
+        bool push(int32_t sample);
+        bool ready();
+        int32_t value();
+        uint8_t getFractionBits();
+    };
+
+    template <int Count, int ExtraBits>
+    void OversampleStage<Count, ExtraBits>::reset() {
+        total = 0;
+        count = 0;
+    }
+
+    template <int Count, int ExtraBits>
+    bool OversampleStage<Count, ExtraBits>::push(int32_t sample, int32_t& output) {
+        total += sample;
+        count++;
+        if (count < Count) return false;
+        //  Count is a constant, so a power of 2 divides with a shift
+        output = total * (1 << ExtraBits) / Count;
+        total = 0;
+        count = 0;
+        return true;
+    }
+
+    template <int Shift>
+    void EmaStage<Shift>::reset() {
+        state = 0;
+        primed = false;
+    }
+
+    template <int Shift>
+    bool EmaStage<Shift>::push(int32_t sample, int32_t& output) {
+        if (!primed) {
+            //  Start at the first sample rather than creeping up from 0
+            state = sample * (1 << Shift);
+            primed = true;
+        } else {
+            state += sample - (state >> Shift);
+        }
+        output = (state + (1 << (Shift - 1))) >> Shift;     //  Rounded to the nearest
+        return true;
+    }
+
+    template <int Size>
+    void MedianStage<Size>::reset() {
+        count = 0;
+        position = 0;
+    }
+
+    template <int Size>
+    bool MedianStage<Size>::push(int32_t sample, int32_t& output) {
+        history[position] = sample;
+        position = (position + 1) % Size;
+        if (count < Size) count++;
+
+        //  Insertion sort a copy, the window is small enough that this beats keeping it sorted
+        int32_t sorted[Size];
+        for (int i = 0; i < count; i++) {
+            int32_t value = history[i];
+            int j = i;
+            while (j > 0 && sorted[j - 1] > value) {
+                sorted[j] = sorted[j - 1];
+                j--;
+            }
+            sorted[j] = value;
+        }
+        output = sorted[count / 2];
+        return true;
+    }
+
+    template <int Decimation, int Order, int ExtraBits>
+    void CicStage<Decimation, Order, ExtraBits>::reset() {
+        for (int i = 0; i < Order; i++) {
+            integrators[i] = 0;
+            combs[i] = 0;
+        }
+        phase = 0;
+    }
+
+    template <int Decimation, int Order, int ExtraBits>
+    bool CicStage<Decimation, Order, ExtraBits>::push(int32_t sample, int32_t& output) {
+        uint32_t value = (uint32_t)sample;
+        for (int i = 0; i < Order; i++) {
+            integrators[i] += value;
+            value = integrators[i];
+        }
+        phase++;
+        if (phase < Decimation) return false;
+        phase = 0;
+
+        for (int i = 0; i < Order; i++) {
+            uint32_t delayed = combs[i];
+            combs[i] = value;
+            value -= delayed;
+        }
+        //  Divide out the gain, apart from the bits being kept
+        output = (int32_t)value >> (growthBits - ExtraBits);
+        return true;
+    }
+
+    template <class... Stages>
+    FilterPipeline<Stages...>::FilterPipeline() {
+        latest = 0;
+        hasOutput = false;
+    }
+
+    template <class... Stages>
+    void FilterPipeline<Stages...>::reset() {
+        stages.reset();
+        latest = 0;
+        hasOutput = false;
+    }
+
+    template <class... Stages>
+    bool FilterPipeline<Stages...>::push(int32_t sample) {
+        int32_t output;
+        if (!stages.push(sample, output)) return false;
+        latest = output;
+        hasOutput = true;
+        return true;
+    }
+
+    template <class... Stages>
+    bool FilterPipeline<Stages...>::ready() {
+        return hasOutput;
+    }
+
+    template <class... Stages>
+    int32_t FilterPipeline<Stages...>::value() {
+        return latest;
+    }
+
+    template <class... Stages>
+    uint8_t FilterPipeline<Stages...>::getFractionBits() {
+        return FilterStages<Stages...>::fractionBits;
+    }
+}
+
+#endif
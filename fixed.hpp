@@ -0,0 +1,101 @@
+// Fixed is a Q16.16 fixed point number, used to convert raw ADC codes into
+// engineering units with integer maths instead of software floating point
+
+//  A header guard prevents the file from being included twice
+#ifndef FIXED_H
+#define FIXED_H
+
+namespace Sensor {
+    class Fixed {
+    private:
+        int32_t value;      //  The number multiplied by 2^16
+
+        //  Used by fromRaw, the bool just tells it apart from the int constructor
+        constexpr Fixed(int32_t raw, bool) : value(raw) {}
+    public:
+        constexpr Fixed() : value(0) {}
+        //  Converting from a double rounds to the nearest step,
+        //  calibration constants should be declared constexpr so this happens at compile time
+        constexpr explicit Fixed(double number) : value((int32_t)(number * 65536.0 + (number < 0 ? -0.5 : 0.5))) {}
+        //  Whole numbers are multiplied up rather than shifted, as shifting a negative number left is undefined
+        constexpr explicit Fixed(int number) : value((int32_t)number * 65536) {}
+
+        static constexpr Fixed fromRaw(int32_t raw) { return Fixed(raw, true); }
+        static Fixed ratio(long numerator, long denominator);
+
+        constexpr int32_t raw() const { return value; }
+        int32_t toInt() const;
+        double toDouble() const;
+
+        Fixed operator+(Fixed other) const;
+        Fixed operator-(Fixed other) const;
+        Fixed operator-() const;
+        Fixed operator*(Fixed other) const;
+        Fixed operator*(int32_t number) const;
+        bool operator<(Fixed other) const;
+        bool operator==(Fixed other) const;
+    };
+
+    Fixed Fixed::ratio(long numerator, long denominator) {
+        //  Divides two integers, keeping 16 bits of the fraction (used for averages)
+        //  The remainder is shifted up 16 bits, so the denominator is reduced until that can't overflow
+        while (denominator > 32767 || denominator < -32767) {
+            numerator /= 2;
+            denominator /= 2;
+        }
+        long whole = numerator / denominator;
+        long remainder = numerator % denominator;
+        return fromRaw(whole * 65536 + remainder * 65536 / denominator);
+    }
+
+    int32_t Fixed::toInt() const {
+        //  Rounds to the nearest whole number
+        return (value + 0x8000) >> 16;
+    }
+
+    double Fixed::toDouble() const {
+        //  Only needed at the edge, where a reading is passed back to the program
+        return (double)value * (1.0 / 65536.0);
+    }
+
+    Fixed Fixed::operator+(Fixed other) const {
+        return fromRaw(value + other.value);
+    }
+
+    Fixed Fixed::operator-(Fixed other) const {
+        return fromRaw(value - other.value);
+    }
+
+    Fixed Fixed::operator-() const {
+        return fromRaw(-value);
+    }
+
+    Fixed Fixed::operator*(Fixed other) const {
+        //  Multiplies the 16 bit halves separately, so no part of the product needs more than 32 bits
+        //  (64 bit maths is even slower than floating point on the AVR)
+        int32_t aHigh = value >> 16;
+        uint32_t aLow = value & 0xFFFF;
+        int32_t bHigh = other.value >> 16;
+        uint32_t bLow = other.value & 0xFFFF;
+        int32_t product = aHigh * bHigh * 65536
+                        + aHigh * (int32_t)bLow
+                        + (int32_t)aLow * bHigh
+                        + (int32_t)((aLow * bLow) >> 16);
+        return fromRaw(product);
+    }
+
+    Fixed Fixed::operator*(int32_t number) const {
+        //  Multiplying by a whole number (such as an ADC code) is a single integer multiply
+        return fromRaw(value * number);
+    }
+
+    bool Fixed::operator<(Fixed other) const {
+        return value < other.value;
+    }
+
+    bool Fixed::operator==(Fixed other) const {
+        return value == other.value;
+    }
+}
+
+#endif
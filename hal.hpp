@@ -0,0 +1,15 @@
+// The hardware abstraction layer, everything the sensors use from the board comes in through here
+// On the board it is the Arduino core, anywhere else it is the simulated board in halHost.hpp,
+// so the sensor manager and the sensors can be built and run on a PC
+
+//  A header guard prevents the file from being included twice
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "halHost.hpp"
+#endif
+
+#endif
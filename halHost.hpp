@@ -0,0 +1,297 @@
+// The host backend of the hardware abstraction layer, a simulated board for building and running
+// the sensors on a PC
+//
+// Time is virtual: it starts at 0 and only moves when delay() or delayMicroseconds() is called,
+// or an analogRead() or RTC read takes the time it would on the board,
+// so runs are repeatable and much faster than real time
+// millis() and micros() are 32 bits and wrap like the board's, and the time can be started just before they do:
+//     hostHal.setTime(4294967296000ULL - 10000000);  //  millis() wraps 10 seconds in
+// The analog pins, digital pins and RTC are set up by the program through hostHal, e.g.
+//     hostHal.setAnalog(A0, 512);
+//     hostHal.setAnalogSource(A1, sineWave);
+//     hostHal.setRtc(1704067200, 20.0);
+//
+// Differences from the board to keep in mind: int and long are wider and double is a real double,
+// so times have to be kept in uint32_t and compared as int32_t differences to wrap the same way
+
+//  A header guard prevents the file from being included twice
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+
+//  The pins of an Uno, the analog pins are also digital pins 14 to 19
+#define HOST_DIGITAL_PINS 20
+#define HOST_ANALOG_PINS 8
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+//  How long analogRead takes on an Uno, in microseconds
+#define HOST_ANALOG_READ_TIME 112
+
+//  How long reading the time from the RTC over I2C at 100kHz takes, in microseconds
+#define HOST_RTC_READ_TIME 900
+
+//  There is only one kind of memory, so program memory strings are normal strings
+#define PROGMEM
+#define PSTR(s) (s)
+#define strncpy_P strncpy
+
+//  Defines an analog source function type, called with the ADC channel and the time in microseconds
+//  and returning the code the ADC reads (0 to 1023)
+typedef int (* AnalogSource)(uint8_t, unsigned long);
+
+//  Defines a digital source function type, called with the pin and the time in microseconds and returning the level
+typedef int (* DigitalSource)(uint8_t, unsigned long);
+
+//  Defines an RTC source function type, called with the time in microseconds and returning the RTC's time (unixtime)
+typedef uint32_t (* RtcSource)(unsigned long);
+
+//  The simulated board
+class HostHal {
+private:
+    uint64_t time;      //  The virtual time in microseconds, which never wraps
+    unsigned long analogReadTime;   //  How long each analogRead takes
+    int analogValues[HOST_ANALOG_PINS];     //  The code each analog pin reads, if it has no source
+    AnalogSource analogSources[HOST_ANALOG_PINS];   //  A function giving the code each analog pin reads
+    uint8_t digitalValues[HOST_DIGITAL_PINS];   //  The level of each digital pin, set by the program or digitalWrite
+    DigitalSource digitalSource;    //  A function giving the level digital pins read, instead of their levels
+    uint8_t pinModes[HOST_DIGITAL_PINS];        //  The mode each pin was last set to
+    unsigned long analogReads;  //  The number of times analogRead has been called
+    unsigned long digitalReads; //  The number of times digitalRead has been called
+
+    uint32_t rtcStart;  //  The RTC's time (unixtime) when the virtual time was 0
+    double rtcRate;     //  How fast the RTC runs compared to the virtual time
+    bool rtcPresent;    //  Whether the RTC answers when it is set up
+    RtcSource rtcSource;    //  A function giving the RTC's time, instead of the simulated RTC
+
+    uint8_t analogChannel(uint8_t pin);
+public:
+    HostHal();
+    void reset();
+    void advance(unsigned long microseconds);
+    void setTime(uint64_t microseconds);
+    uint64_t getTime();
+    void setAnalogReadTime(unsigned long microseconds);
+    void setAnalog(uint8_t pin, int code);
+    void setAnalogSource(uint8_t pin, AnalogSource source);
+    void setDigital(uint8_t pin, uint8_t level);
+    void setDigitalSource(DigitalSource source);
+    uint8_t getDigital(uint8_t pin);
+    uint8_t getPinMode(uint8_t pin);
+    void setRtc(uint32_t unixtime, double ppm = 0, bool present = true);
+    void setRtcSource(RtcSource source);
+    unsigned long getAnalogReads();
+    unsigned long getDigitalReads();
+
+    //  Called by the Arduino functions below
+    int readAnalog(uint8_t pin);
+    int readDigital(uint8_t pin);
+    void writeDigital(uint8_t pin, uint8_t level);
+    void setPinMode(uint8_t pin, uint8_t mode);
+    bool beginRtc();
+    uint32_t readRtc();
+};
+
+HostHal::HostHal() {
+    reset();
+}
+
+void HostHal::reset() {
+    //  Puts the board back how it starts, time 0, every pin reading 0 and the RTC at 01/01/2024
+    time = 0;
+    analogReadTime = HOST_ANALOG_READ_TIME;
+    for (int i = 0; i < HOST_ANALOG_PINS; i++) {
+        analogValues[i] = 0;
+        analogSources[i] = NULL;
+    }
+    for (int i = 0; i < HOST_DIGITAL_PINS; i++) {
+        digitalValues[i] = LOW;
+        pinModes[i] = INPUT;
+    }
+    digitalSource = NULL;
+    analogReads = 0;
+    digitalReads = 0;
+    rtcStart = 1704067200;
+    rtcRate = 1;
+    rtcPresent = true;
+    rtcSource = NULL;
+}
+
+void HostHal::advance(unsigned long microseconds) {
+    time += microseconds;
+}
+
+void HostHal::setTime(uint64_t microseconds) {
+    //  Moves the virtual time, e.g. to just before millis() wraps, the RTC carries on from the time it was showing
+    uint32_t unixtime = rtcStart + (uint32_t)(time * rtcRate / 1000000.0);
+    time = microseconds;
+    rtcStart = unixtime - (uint32_t)(time * rtcRate / 1000000.0);
+}
+
+uint64_t HostHal::getTime() {
+    return time;
+}
+
+void HostHal::setAnalogReadTime(unsigned long microseconds) {
+    //  0 makes reads free, for tests that only care about the values
+    analogReadTime = microseconds;
+}
+
+uint8_t HostHal::analogChannel(uint8_t pin) {
+    //  Allow pins to be passed in as either A0 or 0, like analogRead does
+    if (pin >= A0) pin -= A0;
+    return pin % HOST_ANALOG_PINS;
+}
+
+void HostHal::setAnalog(uint8_t pin, int code) {
+    uint8_t channel = analogChannel(pin);
+    analogValues[channel] = code;
+    analogSources[channel] = NULL;
+}
+
+void HostHal::setAnalogSource(uint8_t pin, AnalogSource source) {
+    analogSources[analogChannel(pin)] = source;
+}
+
+void HostHal::setDigital(uint8_t pin, uint8_t level) {
+    if (pin < HOST_DIGITAL_PINS) digitalValues[pin] = level;
+}
+
+void HostHal::setDigitalSource(DigitalSource source) {
+    //  The source is asked for every digital pin read, so it can give levels that change over time
+    digitalSource = source;
+}
+
+uint8_t HostHal::getDigital(uint8_t pin) {
+    if (pin >= HOST_DIGITAL_PINS) return LOW;
+    return digitalValues[pin];
+}
+
+uint8_t HostHal::getPinMode(uint8_t pin) {
+    if (pin >= HOST_DIGITAL_PINS) return INPUT;
+    return pinModes[pin];
+}
+
+void HostHal::setRtc(uint32_t unixtime, double ppm, bool present) {
+    //  Sets the RTC's time now, how many parts per million fast it runs, and whether it answers at all
+    rtcRate = 1 + ppm / 1000000.0;
+    rtcStart = unixtime - (uint32_t)(time * rtcRate / 1000000.0);
+    rtcPresent = present;
+}
+
+void HostHal::setRtcSource(RtcSource source) {
+    rtcSource = source;
+}
+
+unsigned long HostHal::getAnalogReads() {
+    return analogReads;
+}
+
+unsigned long HostHal::getDigitalReads() {
+    return digitalReads;
+}
+
+int HostHal::readAnalog(uint8_t pin) {
+    //  The value is taken at the start of the conversion, then the conversion time passes
+    uint8_t channel = analogChannel(pin);
+    int code = analogSources[channel] != NULL ? analogSources[channel](channel, time) : analogValues[channel];
+    if (code < 0) code = 0;
+    if (code > 1023) code = 1023;
+    analogReads++;
+    time += analogReadTime;
+    return code;
+}
+
+int HostHal::readDigital(uint8_t pin) {
+    digitalReads++;
+    if (digitalSource != NULL) return digitalSource(pin, time);
+    return getDigital(pin);
+}
+
+void HostHal::writeDigital(uint8_t pin, uint8_t level) {
+    setDigital(pin, level);
+}
+
+void HostHal::setPinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= HOST_DIGITAL_PINS) return;
+    pinModes[pin] = mode;
+    if (mode == INPUT_PULLUP) digitalValues[pin] = HIGH;    //  An unconnected pin is pulled up
+}
+
+bool HostHal::beginRtc() {
+    return rtcPresent;
+}
+
+uint32_t HostHal::readRtc() {
+    //  The time is latched at the start of the read, then the I2C transfer time passes
+    uint32_t unixtime = rtcSource != NULL ? rtcSource(time) : rtcStart + (uint32_t)(time * rtcRate / 1000000.0);
+    time += HOST_RTC_READ_TIME;
+    return unixtime;
+}
+
+HostHal hostHal;
+
+//  The Arduino functions the sensors use, all backed by the simulated board
+//  millis() and micros() wrap at 32 bits like the board's, millis() after 49.7 days and micros() after 71.6 minutes
+uint32_t millis() {
+    return (uint32_t)(hostHal.getTime() / 1000);
+}
+
+uint32_t micros() {
+    return (uint32_t)hostHal.getTime();
+}
+
+void delay(unsigned long milliseconds) {
+    hostHal.advance(milliseconds * 1000);
+}
+
+void delayMicroseconds(unsigned int microseconds) {
+    hostHal.advance(microseconds);
+}
+
+int analogRead(uint8_t pin) {
+    return hostHal.readAnalog(pin);
+}
+
+int digitalRead(uint8_t pin) {
+    return hostHal.readDigital(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    hostHal.writeDigital(pin, level);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    hostHal.setPinMode(pin, mode);
+}
+
+//  Stand ins for the RTClib classes the clock uses, backed by the simulated board's RTC
+class DateTime {
+private:
+    uint32_t time;
+public:
+    DateTime(uint32_t unixtime = 0) : time(unixtime) {}
+    uint32_t unixtime() const { return time; }
+};
+
+class RTC_DS3231 {
+public:
+    bool begin() { return hostHal.beginRtc(); }
+    DateTime now() { return DateTime(hostHal.readRtc()); }
+};
+
+#endif
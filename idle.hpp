@@ -0,0 +1,84 @@
+// Idle strategies decide how the sensor manager's spin waits for the next event
+// Sleeping stops the CPU until an interrupt, which saves most of the power a busy wait burns,
+// busy waiting with delay() is kept for debugging, e.g. with a logic analyser on a pin that toggles in the loop
+//
+// Usage:
+//     manager.setIdleStrategy(&busyIdle);
+
+//  A header guard prevents the file from being included twice
+#ifndef IDLE_H
+#define IDLE_H
+#include "hal.hpp"
+#if defined(ARDUINO) && defined(__AVR__)
+#include <avr/sleep.h>
+#endif
+
+namespace Sensor {
+    class IdleStrategy {
+    public:
+        //  Waits for milliseconds, returns how much of the wait was spent asleep, in microseconds
+        virtual uint32_t idle(uint32_t milliseconds) = 0;
+        //  Whether analog inputs should be converted with the CPU asleep as well
+        virtual bool sleepsForAdc() { return false; }
+    };
+
+    class BusyIdle : public IdleStrategy {
+    public:
+        uint32_t idle(uint32_t milliseconds);
+    };
+
+    class SleepIdle : public IdleStrategy {
+    private:
+        bool adcSleep;      //  Whether analog inputs are converted in ADC noise reduction sleep
+    public:
+        SleepIdle(bool adcNoiseReduction = false);
+        uint32_t idle(uint32_t milliseconds);
+        bool sleepsForAdc();
+    };
+
+    uint32_t BusyIdle::idle(uint32_t milliseconds) {
+        delay(milliseconds);
+        return 0;
+    }
+
+    SleepIdle::SleepIdle(bool adcNoiseReduction) {
+        //  ADC noise reduction sleep needs SENSOR_ADC_STREAM defined for the ADC interrupt
+        //  It stops timer 0 as well, so millis() falls behind by about
+        //  a conversion (0.1 milliseconds) for each analog input read, which is why it is off by default
+        adcSleep = adcNoiseReduction;
+    }
+
+    uint32_t SleepIdle::idle(uint32_t milliseconds) {
+#ifdef SLEEP_MODE_IDLE
+        //  Idle sleep keeps the timers running, so timer 0's overflow interrupt, which counts millis(),
+        //  wakes the CPU about every millisecond to check the time, as does any other interrupt
+        uint32_t start = millis();
+        uint32_t asleep = 0;
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        while (millis() - start < milliseconds) {
+            uint32_t before = micros();
+            sleep_mode();
+            asleep += micros() - before;
+        }
+        return asleep;
+#elif defined(ARDUINO)
+        //  Boards without AVR sleep modes busy wait
+        delay(milliseconds);
+        return 0;
+#else
+        //  The host's virtual clock only moves when waited on, so sleeping is the same as a delay
+        delay(milliseconds);
+        return milliseconds * 1000;
+#endif
+    }
+
+    bool SleepIdle::sleepsForAdc() {
+        return adcSleep;
+    }
+
+    //  The strategies the sensor manager can use, sleeping is the default
+    BusyIdle busyIdle;
+    SleepIdle sleepIdle;
+}
+
+#endif
@@ -0,0 +1,154 @@
+// Indicators drive the status LEDs without blocking, pulses and blinks
+// are timed by the sensor manager's scheduler instead of delay()
+
+//  A header guard prevents the file from being included twice
+#ifndef INDICATOR_H
+#define INDICATOR_H
+#include "scheduler.hpp"
+
+//  The number of LED channels, numbered from 1
+#define INDICATOR_COUNT 3
+
+namespace Sensor {
+    //  Defines a LED command function type, called with the channel and the value to show
+    typedef void (* SendLEDCommand) (int, int);
+
+    //  The patterns an indicator can show
+    enum IndicatorPattern {
+        STEADY_PATTERN, //  Shows a value until told otherwise
+        PULSE_PATTERN,  //  Shows a value once for a set time, then turns off
+        BLINK_PATTERN   //  Switches between a value and off
+    };
+
+    class Indicators {
+    private:
+        struct Channel {
+            uint8_t pattern;        //  The pattern being shown
+            int value;              //  The value shown while the LED is on
+            int shown;              //  The value last sent to the LED, so unchanged values aren't resent
+            unsigned int onTime;    //  How long the value is shown for in pulse and blink patterns
+            unsigned int offTime;   //  How long the LED is off for in blink patterns
+            int event;              //  The scheduler handle that times the pattern
+        };
+
+        Channel channels[INDICATOR_COUNT];
+        Scheduler* scheduler;   //  The scheduler that times pulses and blinks
+        SendLEDCommand sendLEDCommand;  //  Passes LED values on to the program
+
+        void show(int index, int value);
+    public:
+        Indicators();
+        ~Indicators();
+        void begin(Scheduler* eventScheduler, uint8_t eventKind);
+        void setSendLEDCommand(SendLEDCommand command);
+        void steady(int channel, int value);
+        void pulse(int channel, int value, unsigned int duration);
+        void blink(int channel, int value, unsigned int onTime, unsigned int offTime);
+        void process(int index, uint32_t deadline);
+    };
+
+    Indicators::Indicators() {
+        scheduler = NULL;
+        sendLEDCommand = NULL;
+        for (int i = 0; i < INDICATOR_COUNT; i++) {
+            channels[i].pattern = STEADY_PATTERN;
+            channels[i].value = 0;
+            channels[i].shown = -1;  //  Nothing has been sent yet, so the first value is always sent
+            channels[i].event = -1;
+        }
+    }
+
+    Indicators::~Indicators() {
+        //  Don't need to do anything when the object is destroyed
+    }
+
+    void Indicators::begin(Scheduler* eventScheduler, uint8_t eventKind) {
+        //  Adds an event for each channel, which is only scheduled while a pulse or blink is running
+        scheduler = eventScheduler;
+        for (int i = 0; i < INDICATOR_COUNT; i++) {
+            channels[i].event = scheduler->add(eventKind, i, 0, millis());
+            scheduler->cancel(channels[i].event);
+        }
+    }
+
+    void Indicators::setSendLEDCommand(SendLEDCommand command) {
+        sendLEDCommand = command;
+    }
+
+    void Indicators::show(int index, int value) {
+        //  Only sends the value on to the LED if it has changed
+        if (channels[index].shown == value) return;
+        channels[index].shown = value;
+        if (sendLEDCommand != NULL) {
+            sendLEDCommand(index + 1, value);
+        }
+    }
+
+    void Indicators::steady(int channel, int value) {
+        //  Shows a value until the channel is told otherwise, 0 turns it off
+        int index = channel - 1;
+        if (index < 0 || index >= INDICATOR_COUNT) {
+            RAISE_ARG(ERR_INDICATOR_OUT_OF_RANGE, channel);
+            return;
+        }
+        channels[index].pattern = STEADY_PATTERN;
+        channels[index].value = value;
+        scheduler->cancel(channels[index].event);
+        show(index, value);
+    }
+
+    void Indicators::pulse(int channel, int value, unsigned int duration) {
+        //  Shows a value now and turns it off once the duration has passed
+        //  Pulsing again before the end restarts the pulse
+        int index = channel - 1;
+        if (index < 0 || index >= INDICATOR_COUNT) {
+            RAISE_ARG(ERR_INDICATOR_OUT_OF_RANGE, channel);
+            return;
+        }
+        channels[index].pattern = PULSE_PATTERN;
+        channels[index].value = value;
+        channels[index].onTime = duration;
+        show(index, value);
+        scheduler->schedule(channels[index].event, millis() + duration);
+    }
+
+    void Indicators::blink(int channel, int value, unsigned int onTime, unsigned int offTime) {
+        //  Switches between a value and off, starting with the value shown
+        int index = channel - 1;
+        if (index < 0 || index >= INDICATOR_COUNT) {
+            RAISE_ARG(ERR_INDICATOR_OUT_OF_RANGE, channel);
+            return;
+        }
+        //  Blinking with the same timing again carries on the current blink rather than restarting it
+        if (channels[index].pattern == BLINK_PATTERN && channels[index].value == value
+            && channels[index].onTime == onTime && channels[index].offTime == offTime) return;
+        channels[index].pattern = BLINK_PATTERN;
+        channels[index].value = value;
+        channels[index].onTime = onTime;
+        channels[index].offTime = offTime;
+        show(index, value);
+        scheduler->schedule(channels[index].event, millis() + onTime);
+    }
+
+    void Indicators::process(int index, uint32_t deadline) {
+        //  Called by the sensor manager when the channel's event is due
+        Channel& channel = channels[index];
+        if (channel.pattern == PULSE_PATTERN) {
+            //  The pulse is over, so turn the LED off
+            channel.pattern = STEADY_PATTERN;
+            channel.value = 0;
+            show(index, 0);
+        } else if (channel.pattern == BLINK_PATTERN) {
+            //  Toggle the LED, timing the next toggle from this deadline so the blink doesn't drift
+            if (channel.shown == channel.value) {
+                show(index, 0);
+                scheduler->schedule(channel.event, deadline + channel.offTime);
+            } else {
+                show(index, channel.value);
+                scheduler->schedule(channel.event, deadline + channel.onTime);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,91 @@
+// Storage for the logger, a file on an SD card on the board, or a normal file on a PC for testing
+// Both append to the file, padding it to a whole number of blocks first so every block write lines up with a sector
+
+//  A header guard prevents the file from being included twice
+#ifndef LOG_STORAGE_H
+#define LOG_STORAGE_H
+#include "logger.hpp"
+#ifdef ARDUINO
+#include <SD.h>//  Include the SD card library, only needed on the board
+#endif
+
+namespace Sensor {
+#ifdef ARDUINO
+    class SdStorage : public LogStorage {
+    private:
+        File file;  //  The log file on the card
+    public:
+        bool begin(uint8_t chipSelect, const char* name);
+        bool write(const uint8_t* block, int size);
+        bool sync();
+    };
+
+    bool SdStorage::begin(uint8_t chipSelect, const char* name) {
+        //  Starts the card and opens the file, returns false if either fails
+        if (!SD.begin(chipSelect)) return false;
+        file = SD.open(name, FILE_WRITE);
+        if (!file) return false;
+        //  Pad out a file left part way through a block, zeros are skipped when the log is read back
+        while (file.size() % LOGGER_BLOCK_SIZE != 0) {
+            file.write((uint8_t)0);
+        }
+        return true;
+    }
+
+    bool SdStorage::write(const uint8_t* block, int size) {
+        if (!file) return false;
+        return file.write(block, size) == (size_t)size;
+    }
+
+    bool SdStorage::sync() {
+        if (!file) return false;
+        file.flush();
+        return true;
+    }
+#else
+    class FileStorage : public LogStorage {
+    private:
+        FILE* file;     //  The log file
+    public:
+        FileStorage();
+        ~FileStorage();
+        bool begin(const char* name);
+        bool write(const uint8_t* block, int size);
+        bool sync();
+    };
+
+    FileStorage::FileStorage() {
+        file = NULL;
+    }
+
+    FileStorage::~FileStorage() {
+        if (file != NULL) fclose(file);
+    }
+
+    bool FileStorage::begin(const char* name) {
+        //  Opens the file to add to, returns false if it can't be opened
+        file = fopen(name, "ab");
+        if (file == NULL) return false;
+        //  Pad out a file left part way through a block, like the SD card storage does
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        while (size % LOGGER_BLOCK_SIZE != 0) {
+            fputc(0, file);
+            size++;
+        }
+        return true;
+    }
+
+    bool FileStorage::write(const uint8_t* block, int size) {
+        if (file == NULL) return false;
+        return fwrite(block, 1, size, file) == (size_t)size;
+    }
+
+    bool FileStorage::sync() {
+        if (file == NULL) return false;
+        return fflush(file) == 0;
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,267 @@
+// The logger stores telemetry frames, packing them into a RAM ring of 512 byte blocks
+// and writing whole blocks to storage, so an SD card sees sector sized writes instead of one per sample
+//
+// Frames are added from the callback path and never wait for storage. Blocks are written by the sensor manager
+// in idle time, when the next event is further away than the write budget, or straight away once the next frame
+// wouldn't fit, in which case events wait for the write rather than frames being lost. If the ring fills up anyway,
+// the drop policy decides whether the newest frame or the oldest block is thrown away, and both are counted
+//
+// Frames run on from one block into the next, and a block written before it is full is padded with zeros,
+// which the telemetry decoder skips while it looks for the next frame, so the log reads back as one stream
+//
+// Usage:
+//     FileStorage storage;    //  or SdStorage on the board, see logStorage.hpp
+//     storage.begin("log.bin");
+//     Logger logger(&storage);
+//     manager.setLogger(&logger);
+
+//  A header guard prevents the file from being included twice
+#ifndef LOGGER_H
+#define LOGGER_H
+#include "check.hpp"
+
+//  The size of a block, one SD card sector
+#define LOGGER_BLOCK_SIZE 512
+
+//  The number of blocks in the ring by default, one being filled while the others wait to be written,
+//  so a full block can wait for a gap between events as long as the budget without the ring filling
+#define LOGGER_BLOCKS 3
+
+//  How long a block write is expected to take by default, in milliseconds,
+//  blocks are only written when the next event is at least this far away
+#define LOGGER_WRITE_BUDGET 10
+
+//  How many blocks are written between syncs, which update the file's size on the card
+#define LOGGER_SYNC_BLOCKS 16
+
+namespace Sensor {
+    //  What to throw away when a frame doesn't fit in the ring
+    enum LogDropPolicy {
+        LOG_DROP_NEWEST,    //  Keep what's in the ring and drop the frame
+        LOG_DROP_OLDEST     //  Drop the oldest full blocks to make room for the frame
+    };
+
+    //  Where the logger writes its blocks, so the same logger can write to an SD card or a file
+    class LogStorage {
+    public:
+        virtual bool write(const uint8_t* block, int size) = 0;   //  Appends a block, returns false if it wasn't written
+        virtual bool sync() = 0;    //  Makes sure everything written so far is stored
+    };
+
+    class Logger {
+    private:
+        LogStorage* storage;
+        uint8_t* blocks;        //  The ring of blocks
+        int blockCount;         //  The number of blocks in the ring
+        int first;              //  The oldest full block, the next to be written
+        int fullBlocks;         //  The number of full blocks waiting to be written
+        int position;           //  How much of the block after the full ones has been filled
+        uint8_t policy;         //  What to drop when the ring is full
+        unsigned int writeBudget;   //  The time to leave for a write, in milliseconds
+        int unsynced;           //  The blocks written since the last sync
+
+        unsigned long framesLogged;     //  The frames added to the ring
+        unsigned long framesDropped;    //  The frames that didn't fit, with LOG_DROP_NEWEST
+        unsigned long blocksDropped;    //  The full blocks thrown away, with LOG_DROP_OLDEST
+        unsigned long blocksWritten;    //  The blocks written to storage
+        unsigned long writeErrors;      //  The block writes that failed, the block is tried again next time
+        unsigned long syncErrors;       //  The syncs that failed after a block was written, tried again after the next block
+        unsigned long maxWriteTime;     //  The longest block write, in milliseconds
+        int maxUsed;            //  The most bytes the ring has held at once
+        int maxFrame;           //  The longest frame logged, to tell whether the next one will fit
+
+        int used();
+    public:
+        Logger(LogStorage* storage, int blocks = LOGGER_BLOCKS);
+        ~Logger();
+        void setDropPolicy(uint8_t dropPolicy);
+        void setWriteBudget(unsigned int budget);
+        unsigned int getWriteBudget();
+        bool log(const uint8_t* data, int length);
+        bool hasFullBlock();
+        bool isNearlyFull();
+        bool writeBlock();
+        bool flush();
+        int getFree();
+        unsigned long getFramesLogged();
+        unsigned long getFramesDropped();
+        unsigned long getBlocksDropped();
+        unsigned long getBlocksWritten();
+        unsigned long getWriteErrors();
+        unsigned long getSyncErrors();
+        unsigned long getMaxWriteTime();
+        int getMaxUsed();
+    };
+
+    Logger::Logger(LogStorage* storage, int blocks) : storage(storage), blockCount(blocks) {
+        //  At least 2 blocks are needed, so one can be filled while the other is written
+        if (blockCount < 2) blockCount = 2;
+        this->blocks = (uint8_t*)malloc(LOGGER_BLOCK_SIZE * blockCount);
+        first = 0;
+        fullBlocks = 0;
+        position = 0;
+        policy = LOG_DROP_NEWEST;
+        writeBudget = LOGGER_WRITE_BUDGET;
+        unsynced = 0;
+        framesLogged = 0;
+        framesDropped = 0;
+        blocksDropped = 0;
+        blocksWritten = 0;
+        writeErrors = 0;
+        syncErrors = 0;
+        maxWriteTime = 0;
+        maxUsed = 0;
+        maxFrame = 0;
+    }
+
+    Logger::~Logger() {
+        free(blocks);
+    }
+
+    void Logger::setDropPolicy(uint8_t dropPolicy) {
+        policy = dropPolicy;
+    }
+
+    void Logger::setWriteBudget(unsigned int budget) {
+        //  Should be more than the storage usually takes to write a block, or writes will be late for events
+        writeBudget = budget;
+    }
+
+    unsigned int Logger::getWriteBudget() {
+        return writeBudget;
+    }
+
+    int Logger::used() {
+        return fullBlocks * LOGGER_BLOCK_SIZE + position;
+    }
+
+    int Logger::getFree() {
+        //  The space left in the ring, callers can log less often when it is getting low
+        return blockCount * LOGGER_BLOCK_SIZE - used();
+    }
+
+    bool Logger::log(const uint8_t* data, int length) {
+        //  Copies a frame into the ring, returns false if it was dropped
+        //  Only ever copies, so it is quick enough to call between sensor events
+        if (length > maxFrame) maxFrame = length;
+        if (length > getFree()) {
+            //  Drop the oldest blocks if that makes enough room, otherwise drop the frame
+            int blocksNeeded = (length - getFree() + LOGGER_BLOCK_SIZE - 1) / LOGGER_BLOCK_SIZE;
+            if (policy != LOG_DROP_OLDEST || blocksNeeded > fullBlocks) {
+                framesDropped++;
+                return false;
+            }
+            first = (first + blocksNeeded) % blockCount;
+            fullBlocks -= blocksNeeded;
+            blocksDropped += blocksNeeded;
+        }
+
+        //  Frames can run on into the next block
+        while (length > 0) {
+            uint8_t* block = blocks + ((first + fullBlocks) % blockCount) * LOGGER_BLOCK_SIZE;
+            int size = LOGGER_BLOCK_SIZE - position;
+            if (size > length) size = length;
+            memcpy(block + position, data, size);
+            data += size;
+            length -= size;
+            position += size;
+            if (position == LOGGER_BLOCK_SIZE) {
+                fullBlocks++;
+                position = 0;
+            }
+        }
+
+        framesLogged++;
+        if (used() > maxUsed) maxUsed = used();
+        return true;
+    }
+
+    bool Logger::hasFullBlock() {
+        return fullBlocks > 0;
+    }
+
+    bool Logger::isNearlyFull() {
+        //  Whether the next frame, if it is as long as the longest so far, wouldn't fit in the ring
+        //  Until then full blocks can wait for time between events
+        return fullBlocks > 0 && getFree() < maxFrame;
+    }
+
+    bool Logger::writeBlock() {
+        //  Writes the oldest full block, returns false if there wasn't one or it couldn't be written
+        //  Called by the sensor manager when there is time before the next event
+        if (fullBlocks == 0) return false;
+
+        unsigned long start = millis();
+        bool written = storage->write(blocks + first * LOGGER_BLOCK_SIZE, LOGGER_BLOCK_SIZE);
+        if (written) {
+            first = (first + 1) % blockCount;
+            fullBlocks--;
+            blocksWritten++;
+            //  The block is written whether or not the sync works, so it isn't written twice,
+            //  a failed sync is counted and tried again after the next block
+            if (++unsynced >= LOGGER_SYNC_BLOCKS) {
+                if (storage->sync()) {
+                    unsynced = 0;
+                } else {
+                    syncErrors++;
+                }
+            }
+        } else {
+            //  Keep the block to try again, if storage stays broken the ring fills and frames are dropped
+            writeErrors++;
+        }
+        unsigned long time = millis() - start;
+        if (time > maxWriteTime) maxWriteTime = time;
+        return written;
+    }
+
+    bool Logger::flush() {
+        //  Pads the block being filled and writes every block, then syncs
+        //  This waits for storage, so it is for stopping logging, not for calling while sensors are running
+        if (position > 0) {
+            uint8_t* block = blocks + ((first + fullBlocks) % blockCount) * LOGGER_BLOCK_SIZE;
+            memset(block + position, 0, LOGGER_BLOCK_SIZE - position);
+            fullBlocks++;
+            position = 0;
+        }
+        while (fullBlocks > 0) {
+            if (!writeBlock()) return false;
+        }
+        unsynced = 0;
+        return storage->sync();
+    }
+
+    unsigned long Logger::getFramesLogged() {
+        return framesLogged;
+    }
+
+    unsigned long Logger::getFramesDropped() {
+        return framesDropped;
+    }
+
+    unsigned long Logger::getBlocksDropped() {
+        return blocksDropped;
+    }
+
+    unsigned long Logger::getBlocksWritten() {
+        return blocksWritten;
+    }
+
+    unsigned long Logger::getWriteErrors() {
+        return writeErrors;
+    }
+
+    unsigned long Logger::getSyncErrors() {
+        return syncErrors;
+    }
+
+    unsigned long Logger::getMaxWriteTime() {
+        return maxWriteTime;
+    }
+
+    int Logger::getMaxUsed() {
+        return maxUsed;
+    }
+}
+
+#endif
@@ -1,24 +1,122 @@
 // Code that registers a push button on the driving steering wheel, for diagnostics
+// The button is debounced, and turned into events: pressed, released, long press and double press
+// With enableInterrupt() a pin change interrupt queues every edge with its time as it happens,
+// otherwise the pin is polled on the button's ticks and reports
+// The pin change interrupts are only taken if BUTTON_PCINT is defined before any sensor is included,
+// so libraries with their own (e.g. SoftwareSerial) still link, otherwise enableInterrupt() returns false
 
 #ifndef PUSHBUTTON_H
 #define PUSHBUTTON_H
-//#include <Arduino.h> check if this line is required---------------
 #include "sensor.hpp"
 
+//  How long the pin has to stay at one level after an edge to count as a press or release, in milliseconds
+#define BUTTON_DEBOUNCE 20
+
+//  How long the button has to be held for a long press, in milliseconds
+#define BUTTON_LONG_PRESS 1000
+
+//  The longest gap between a release and the next press for a double press, in milliseconds
+#define BUTTON_DOUBLE_PRESS 400
+
+//  The number of edges the interrupt can queue, and of events waiting to be taken, must be powers of 2
+#define BUTTON_EDGE_QUEUE 8
+#define BUTTON_EVENT_QUEUE 8
+
+//  The max number of buttons using pin change interrupts
+#define BUTTON_MAX_INTERRUPTS 4
+
+//  Whether buttons can use the pin change interrupts, on boards that have them when they have been asked for
+#if defined(BUTTON_PCINT) && defined(PCICR) && defined(digitalPinToPCICR)
+#define BUTTON_PCINT_AVAILABLE
+#endif
+
 namespace Sensor {
+    //  The events a button produces
+    enum ButtonEventKind {
+        BUTTON_PRESSED,
+        BUTTON_RELEASED,
+        BUTTON_LONG_PRESSED,    //  Held for the long press time, sent while it is still held
+        BUTTON_DOUBLE_PRESSED   //  Pressed again soon after a short press, sent after its pressed event
+    };
+
+    struct ButtonEvent {
+        uint8_t kind;
+        uint32_t time;     //  When it happened (millis), the start of the bounce for presses and releases
+    };
+
+    //  A raw edge on the pin, before debouncing
+    struct ButtonEdge {
+        uint32_t time;
+        uint8_t level;
+    };
+
     class PushButton : public Sensor{
     private:
-        uint8_t buttonPin;     // Pin number where the button is connected
+        DigitalInput buttonPin;     // Pin number where the button is connected
+
+        //  The raw edges, written by the interrupt (or by polling) and read by update
+        ButtonEdge edges[BUTTON_EDGE_QUEUE];
+        volatile uint8_t edgeHead;      //  Where the next edge is written, only changed by the interrupt
+        volatile uint8_t edgeTail;      //  Where the next edge is read from, only changed outside the interrupt
+        volatile uint8_t lastLevel;     //  The level of the last edge queued
+        volatile uint32_t overflows;   //  The number of edges dropped because the queue was full
+        bool interrupt;     //  Whether edges come from the pin change interrupt
+
+        bool pressed;       //  The debounced state
+        bool bouncing;      //  Whether there have been edges that haven't settled yet
+        uint8_t bounceLevel;    //  The level of the last of those edges
+        uint32_t bounceStart;  //  When the first of them happened
+        uint32_t lastEdge;     //  When the last of them happened
+        uint32_t pressTime;    //  When the button was last pressed
+        uint32_t releaseTime;  //  When the button was last released
+        bool longSent;      //  Whether the long press for this press has been sent
+        bool doubleArmed;   //  Whether the next press can be a double press
+
+        ButtonEvent events[BUTTON_EVENT_QUEUE];
+        uint8_t eventHead;
+        uint8_t eventTail;
+
+        static PushButton* interruptButtons[BUTTON_MAX_INTERRUPTS];
+        static uint8_t interruptCount;
+
+        void queueEdge(uint8_t level, uint32_t time);
+        void queueEvent(uint8_t kind, uint32_t time);
+        void settle(uint32_t time);
     public:
         PushButton(uint8_t pin);  // Constructor
         ~PushButton();      // Destructor
-        void setup();
-        void tick();        // Sets up the button pin
-        double report();    // Reads the button state with debounce logic
+        void setup();       // Sets up the button pin
+        bool enableInterrupt();
+        void tick();        // Polls the button if there is no interrupt
+        double report();    // Reports the debounced state, 1 while pressed
+        void attach(Acquisition& acquisition);
+        void update();
+        bool getEvent(ButtonEvent& event);
+        bool isPressed();
+        uint32_t getOverflows();
+        static void pinChanged();
     };
 
-    PushButton::PushButton(uint8_t pin) {
-        buttonPin = pin;
+    PushButton* PushButton::interruptButtons[BUTTON_MAX_INTERRUPTS];
+    uint8_t PushButton::interruptCount = 0;
+
+    PushButton::PushButton(uint8_t pin) : buttonPin(pin) {
+        edgeHead = 0;
+        edgeTail = 0;
+        lastLevel = HIGH;   //  Not pressed, the button pulls the pin low
+        overflows = 0;
+        interrupt = false;
+        pressed = false;
+        bouncing = false;
+        bounceLevel = HIGH;
+        bounceStart = 0;
+        lastEdge = 0;
+        pressTime = 0;
+        releaseTime = 0;
+        longSent = false;
+        doubleArmed = false;
+        eventHead = 0;
+        eventTail = 0;
     }
 
     PushButton::~PushButton() {
@@ -26,18 +124,177 @@ namespace Sensor {
     }
 
     void PushButton::setup() {
-        pinMode(buttonPin, INPUT);
+        pinMode(buttonPin.getPin(), INPUT);
+        lastLevel = digitalRead(buttonPin.getPin());
+        bounceLevel = lastLevel;
+        pressed = lastLevel == LOW;
+    }
+
+    bool PushButton::enableInterrupt() {
+        //  Queues edges from the pin change interrupt, returns false if the board can't,
+        //  in which case the button keeps being polled
+#ifdef BUTTON_PCINT_AVAILABLE
+        uint8_t pin = buttonPin.getPin();
+        if (digitalPinToPCICR(pin) == NULL || interruptCount >= BUTTON_MAX_INTERRUPTS) return false;
+        if (interrupt) return true;
+        uint8_t oldSREG = SREG;
+        cli();
+        lastLevel = digitalRead(pin);
+        interruptButtons[interruptCount++] = this;
+        interrupt = true;
+        *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+        *digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));
+        SREG = oldSREG;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void PushButton::pinChanged() {
+        //  Called from the pin change interrupts, queues an edge for each button whose pin changed
+        //  The pins share interrupts, so every button is checked
+        uint32_t now = millis();
+        for (uint8_t i = 0; i < interruptCount; i++) {
+            PushButton* button = interruptButtons[i];
+            uint8_t level = digitalRead(button->buttonPin.getPin());
+            if (level != button->lastLevel) {
+                button->queueEdge(level, now);
+            }
+        }
+    }
+
+    void PushButton::queueEdge(uint8_t level, uint32_t time) {
+        uint8_t index = edgeHead;
+        uint8_t next = (index + 1) & (BUTTON_EDGE_QUEUE - 1);
+        if (next == edgeTail) {
+            //  Leave the last level alone, so the next edge that fits still shows the change
+            overflows++;
+            return;
+        }
+        edges[index].time = time;
+        edges[index].level = level;
+        lastLevel = level;
+        edgeHead = next;
+    }
+
+    void PushButton::queueEvent(uint8_t kind, uint32_t time) {
+        //  Events are taken in the same context they are made in, if the queue is full the oldest is dropped
+        uint8_t next = (eventHead + 1) & (BUTTON_EVENT_QUEUE - 1);
+        if (next == eventTail) {
+            eventTail = (eventTail + 1) & (BUTTON_EVENT_QUEUE - 1);
+        }
+        events[eventHead].kind = kind;
+        events[eventHead].time = time;
+        eventHead = next;
+    }
+
+    void PushButton::attach(Acquisition& acquisition) {
+        // Read the button in the sensor manager's acquisition pass
+        buttonPin.attach(acquisition);
+    }
+
+    void PushButton::update() {
+        //  Debounces the queued edges and works out the events from them
+        //  Called on ticks and reports, and whenever events are taken
+        uint32_t now = millis();
+        if (!interrupt) {
+            uint8_t level = buttonPin.read();
+            if (level != lastLevel) {
+                queueEdge(level, now);
+            }
+        }
+
+        //  Edges close together are one bounce, which is timed from its first edge
+        while (edgeTail != edgeHead) {
+            uint8_t index = edgeTail;
+            if (!bouncing) {
+                bouncing = true;
+                bounceStart = edges[index].time;
+            }
+            bounceLevel = edges[index].level;
+            lastEdge = edges[index].time;
+            edgeTail = (index + 1) & (BUTTON_EDGE_QUEUE - 1);
+        }
+        if (bouncing && now - lastEdge >= BUTTON_DEBOUNCE) {
+            bouncing = false;
+            settle(bounceStart);
+        }
+
+        if (pressed && !longSent && now - pressTime >= BUTTON_LONG_PRESS) {
+            longSent = true;
+            queueEvent(BUTTON_LONG_PRESSED, pressTime + BUTTON_LONG_PRESS);
+        }
+    }
+
+    void PushButton::settle(uint32_t time) {
+        //  The pin has stopped bouncing, a bounce that ends where it started isn't a press or release
+        bool down = bounceLevel == LOW;
+        if (down == pressed) return;
+        pressed = down;
+        if (down) {
+            queueEvent(BUTTON_PRESSED, time);
+            if (doubleArmed && time - releaseTime <= BUTTON_DOUBLE_PRESS) {
+                queueEvent(BUTTON_DOUBLE_PRESSED, time);
+                doubleArmed = false;    //  A third press starts again
+            } else {
+                doubleArmed = true;
+            }
+            pressTime = time;
+            longSent = false;
+        } else {
+            queueEvent(BUTTON_RELEASED, time);
+            releaseTime = time;
+            //  The press after a long press isn't a double press
+            if (longSent) doubleArmed = false;
+        }
+    }
+
+    bool PushButton::getEvent(ButtonEvent& event) {
+        //  Takes the oldest event, returns false if there aren't any
+        update();
+        if (eventTail == eventHead) return false;
+        event = events[eventTail];
+        eventTail = (eventTail + 1) & (BUTTON_EVENT_QUEUE - 1);
+        return true;
+    }
+
+    bool PushButton::isPressed() {
+        return pressed;
+    }
+
+    uint32_t PushButton::getOverflows() {
+        return overflows;
     }
 
     void PushButton::tick() {
-        // No averaging needed for push button
+        // No averaging needed for push button, just keep the debouncing up to date
+        update();
     }
 
     double PushButton::report() {
-        bool reading = digitalRead(buttonPin);  // read pit confirm HIGH/LOW state
-        double output = reading ? 0.0 : 1.0;    // Converts to double and flips polarity of reading
-        return output;
+        update();
+        return pressed ? 1.0 : 0.0;
     }
 }
 
+#ifdef BUTTON_PCINT_AVAILABLE
+//  The pin change interrupts pass every change to the buttons
+#ifdef PCINT0_vect
+ISR(PCINT0_vect) {
+    Sensor::PushButton::pinChanged();
+}
+#endif
+#ifdef PCINT1_vect
+ISR(PCINT1_vect) {
+    Sensor::PushButton::pinChanged();
+}
+#endif
+#ifdef PCINT2_vect
+ISR(PCINT2_vect) {
+    Sensor::PushButton::pinChanged();
+}
+#endif
+#endif
+
 #endif
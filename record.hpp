@@ -0,0 +1,120 @@
+// Recording keeps the raw inputs the sensors read, ADC codes, digital levels and RTC times,
+// with when they were read, so a session can be played back later through the same sensors, see replay.hpp
+// Only compiled in if SENSOR_RECORD is defined before any sensor is included, otherwise the hooks are empty
+//
+// Usage:
+//     #define SENSOR_RECORD
+//     ...
+//     Logger captureLogger(&storage);
+//     recorder.begin(&captureLogger);
+//     manager.setCaptureLogger(&captureLogger);   //  So its blocks are written out in idle time
+//
+// Nothing is written out before the manager spins, so sensors that poll an input in setup(), e.g. the clock
+// waiting for the RTC's second to change, need a ring big enough to hold those reads
+//
+// The stream is a list of records, each one
+//     byte      kind in the top 2 bits (RECORD_ANALOG, RECORD_DIGITAL or RECORD_RTC), pin or ADC channel in the bottom 6
+//     varint    microseconds since the last record, 7 bits a byte, least significant first, top bit set if more follow
+//     value     u16 ADC code, u8 digital level or u32 unixtime, little endian
+// A 0 byte where a record should start is padding from the logger, and is skipped
+// The logger should drop new records rather than old blocks when it is full, so the stream is never cut part way through a record
+
+//  A header guard prevents the file from being included twice
+#ifndef RECORD_H
+#define RECORD_H
+#include "logger.hpp"
+
+//  The kinds of record, 0 is left for padding
+#define RECORD_ANALOG 1
+#define RECORD_DIGITAL 2
+#define RECORD_RTC 3
+
+//  The longest record, a header byte, a 5 byte time and a 4 byte value
+#define RECORD_MAX_SIZE 10
+
+//  The hooks the inputs call, which do nothing unless recording is compiled in
+#ifdef SENSOR_RECORD
+#define RECORD_INPUT(kind, pin, value) ::Sensor::recorder.add(kind, pin, value)
+#else
+#define RECORD_INPUT(kind, pin, value)
+#endif
+
+namespace Sensor {
+    class Recorder {
+    private:
+        Logger* logger;         //  Where the records go, nothing is recorded without one
+        uint32_t lastTime; //  When the last record kept was read (micros)
+        unsigned long records;  //  The records kept
+        unsigned long dropped;  //  The records the logger had no room for
+    public:
+        Recorder();
+        void begin(Logger* captureLogger);
+        void end();
+        void add(uint8_t kind, uint8_t pin, uint32_t value);
+        unsigned long getRecords();
+        unsigned long getDropped();
+    };
+
+    Recorder::Recorder() {
+        logger = NULL;
+        lastTime = 0;
+        records = 0;
+        dropped = 0;
+    }
+
+    void Recorder::begin(Logger* captureLogger) {
+        //  Starts recording, record times count from now
+        lastTime = micros();
+        logger = captureLogger;
+    }
+
+    void Recorder::end() {
+        //  Stops recording, the logger still has to be flushed
+        logger = NULL;
+    }
+
+    void Recorder::add(uint8_t kind, uint8_t pin, uint32_t value) {
+        //  Packs an input into a record and gives it to the logger, which only copies it
+        if (logger == NULL) return;
+        uint32_t now = micros();
+        uint32_t delta = now - lastTime;
+
+        uint8_t record[RECORD_MAX_SIZE];
+        int length = 0;
+        record[length++] = (kind << 6) | (pin & 0x3F);
+        do {
+            record[length] = delta & 0x7F;
+            delta >>= 7;
+            if (delta != 0) record[length] |= 0x80;
+            length++;
+        } while (delta != 0);
+        record[length++] = value;
+        if (kind != RECORD_DIGITAL) record[length++] = value >> 8;
+        if (kind == RECORD_RTC) {
+            record[length++] = value >> 16;
+            record[length++] = value >> 24;
+        }
+
+        //  Times are from the last record kept, so a dropped record doesn't throw the times after it out
+        if (logger->log(record, length)) {
+            lastTime = now;
+            records++;
+        } else {
+            dropped++;
+        }
+    }
+
+    unsigned long Recorder::getRecords() {
+        return records;
+    }
+
+    unsigned long Recorder::getDropped() {
+        return dropped;
+    }
+
+#ifdef SENSOR_RECORD
+    Recorder recorder;
+#endif
+}
+
+#endif
@@ -0,0 +1,252 @@
+// Replay plays a recording made with record.hpp back through the host HAL, so the unchanged sensors
+// and sensor manager read the inputs captured on the board, as fast as the PC can run them
+// Used for regression tests that give the same readings every run, and for trying conversion and filter changes
+// on real inputs
+//
+// Usage:
+//     replay.load("capture.bin");
+//     replay.begin();
+//     manager.spin(replay.getDuration() / 1000);
+//
+// By time, each read gets the last value recorded for its pin at or before the same time into the recording,
+// which follows the recording even if the sensors read more or less often than they did
+// In order, each read gets the next value recorded for its pin, which gives back exactly what was read
+// as long as the sensors read the pins in the same order as when they were recorded
+
+//  A header guard prevents the file from being included twice
+#ifndef REPLAY_H
+#define REPLAY_H
+#ifdef ARDUINO
+#error "Replay runs on the host HAL, it can't be built for the board"
+#endif
+#include "record.hpp"
+#include <vector>
+
+namespace Sensor {
+    //  How recorded values are matched to reads
+    enum ReplayMode {
+        REPLAY_BY_TIME,     //  The last value recorded by the time of the read
+        REPLAY_IN_ORDER     //  The next value recorded for the pin
+    };
+
+    //  A recorded value and when it was read, in microseconds from the start of the recording
+    struct ReplayInput {
+        unsigned long time;
+        uint32_t value;
+    };
+
+    class Replay {
+    private:
+        //  The recorded values of one input
+        struct Track {
+            std::vector<ReplayInput> inputs;
+            size_t next;        //  The next value to give back
+            uint32_t current;   //  The last value given back
+        };
+
+        Track analog[HOST_ANALOG_PINS];
+        Track digital[HOST_DIGITAL_PINS];
+        Track rtc;
+        uint8_t mode;
+        unsigned long startTime;    //  The host time the replay started at
+        unsigned long duration;     //  The time of the last record
+        unsigned long records;      //  The records loaded
+        unsigned long badRecords;   //  The records that were cut short or for pins the host doesn't have
+        unsigned long underruns;    //  The reads in order after a pin's values ran out, which get its last value again
+
+        void clear();
+        void rewind(Track& track);
+        uint32_t take(Track& track, unsigned long time);
+        static int analogSource(uint8_t channel, unsigned long time);
+        static int digitalSource(uint8_t pin, unsigned long time);
+        static uint32_t rtcSource(unsigned long time);
+    public:
+        Replay();
+        bool load(const char* name);
+        void parse(const uint8_t* data, size_t length);
+        void begin(uint8_t replayMode = REPLAY_BY_TIME);
+        void end();
+        bool isFinished();
+        unsigned long getDuration();
+        unsigned long getRecords();
+        unsigned long getBadRecords();
+        unsigned long getUnderruns();
+    };
+
+    Replay::Replay() {
+        clear();
+    }
+
+    void Replay::clear() {
+        for (int i = 0; i < HOST_ANALOG_PINS; i++) {
+            analog[i].inputs.clear();
+        }
+        for (int i = 0; i < HOST_DIGITAL_PINS; i++) {
+            digital[i].inputs.clear();
+        }
+        rtc.inputs.clear();
+        mode = REPLAY_BY_TIME;
+        startTime = 0;
+        duration = 0;
+        records = 0;
+        badRecords = 0;
+        underruns = 0;
+    }
+
+    bool Replay::load(const char* name) {
+        //  Reads a whole recording from a file, returns false if it can't be read
+        FILE* file = fopen(name, "rb");
+        if (file == NULL) return false;
+        std::vector<uint8_t> data;
+        uint8_t buffer[LOGGER_BLOCK_SIZE];
+        size_t length;
+        while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            data.insert(data.end(), buffer, buffer + length);
+        }
+        fclose(file);
+        parse(data.data(), data.size());
+        return true;
+    }
+
+    void Replay::parse(const uint8_t* data, size_t length) {
+        //  Splits a recording into the values for each input, replacing anything loaded before
+        clear();
+        unsigned long time = 0;
+        size_t position = 0;
+        while (position < length) {
+            uint8_t header = data[position++];
+            if (header == 0) continue;  //  Padding
+            uint8_t kind = header >> 6;
+            uint8_t pin = header & 0x3F;
+
+            uint32_t delta = 0;
+            int shift = 0;
+            bool more = true;
+            while (more && position < length && shift < 35) {
+                delta |= (uint32_t)(data[position] & 0x7F) << shift;
+                more = data[position++] & 0x80;
+                shift += 7;
+            }
+            int size = kind == RECORD_DIGITAL ? 1 : kind == RECORD_RTC ? 4 : 2;
+            if (kind == 0 || more || position + size > length) {
+                //  Not a record, try the next byte
+                badRecords++;
+                continue;
+            }
+            uint32_t value = 0;
+            for (int i = 0; i < size; i++) {
+                value |= (uint32_t)data[position++] << (8 * i);
+            }
+            time += delta;
+
+            Track* track = NULL;
+            if (kind == RECORD_ANALOG && pin < HOST_ANALOG_PINS) track = &analog[pin];
+            if (kind == RECORD_DIGITAL && pin < HOST_DIGITAL_PINS) track = &digital[pin];
+            if (kind == RECORD_RTC) track = &rtc;
+            if (track == NULL) {
+                badRecords++;
+                continue;
+            }
+            ReplayInput input = {time, value};
+            track->inputs.push_back(input);
+            records++;
+            duration = time;
+        }
+    }
+
+    void Replay::rewind(Track& track) {
+        track.next = 0;
+        track.current = track.inputs.empty() ? 0 : track.inputs[0].value;
+    }
+
+    void Replay::begin(uint8_t replayMode) {
+        //  Starts playing the recording from the beginning, with its start at the host time now
+        mode = replayMode;
+        startTime = hostHal.getTime();
+        underruns = 0;
+        for (int i = 0; i < HOST_ANALOG_PINS; i++) {
+            rewind(analog[i]);
+            hostHal.setAnalogSource(i, analogSource);
+        }
+        for (int i = 0; i < HOST_DIGITAL_PINS; i++) {
+            rewind(digital[i]);
+        }
+        rewind(rtc);
+        hostHal.setDigitalSource(digitalSource);
+        hostHal.setRtcSource(rtcSource);
+    }
+
+    void Replay::end() {
+        //  Gives the inputs back to the host HAL's own values
+        for (int i = 0; i < HOST_ANALOG_PINS; i++) {
+            hostHal.setAnalogSource(i, NULL);
+        }
+        hostHal.setDigitalSource(NULL);
+        hostHal.setRtcSource(NULL);
+    }
+
+    uint32_t Replay::take(Track& track, unsigned long time) {
+        //  The value for a read at a host time
+        if (mode == REPLAY_IN_ORDER) {
+            if (track.next < track.inputs.size()) {
+                track.current = track.inputs[track.next++].value;
+            } else if (!track.inputs.empty()) {
+                underruns++;
+            }
+        } else {
+            unsigned long elapsed = time - startTime;
+            while (track.next < track.inputs.size() && track.inputs[track.next].time <= elapsed) {
+                track.current = track.inputs[track.next++].value;
+            }
+        }
+        return track.current;
+    }
+
+    bool Replay::isFinished() {
+        //  Whether the replay has got to the end of the recording
+        if (mode == REPLAY_BY_TIME) return hostHal.getTime() - startTime >= duration;
+        for (int i = 0; i < HOST_ANALOG_PINS; i++) {
+            if (analog[i].next < analog[i].inputs.size()) return false;
+        }
+        for (int i = 0; i < HOST_DIGITAL_PINS; i++) {
+            if (digital[i].next < digital[i].inputs.size()) return false;
+        }
+        return rtc.next >= rtc.inputs.size();
+    }
+
+    unsigned long Replay::getDuration() {
+        //  How long the recording is, in microseconds
+        return duration;
+    }
+
+    unsigned long Replay::getRecords() {
+        return records;
+    }
+
+    unsigned long Replay::getBadRecords() {
+        return badRecords;
+    }
+
+    unsigned long Replay::getUnderruns() {
+        return underruns;
+    }
+
+    Replay replay;
+
+    //  The host HAL's sources, which ask the replay for the value of each read
+    int Replay::analogSource(uint8_t channel, unsigned long time) {
+        return replay.take(replay.analog[channel], time);
+    }
+
+    int Replay::digitalSource(uint8_t pin, unsigned long time) {
+        //  Pins that weren't recorded keep the level the host HAL gives them
+        if (pin >= HOST_DIGITAL_PINS || replay.digital[pin].inputs.empty()) return hostHal.getDigital(pin);
+        return replay.take(replay.digital[pin], time);
+    }
+
+    uint32_t Replay::rtcSource(unsigned long time) {
+        return replay.take(replay.rtc, time);
+    }
+}
+
+#endif
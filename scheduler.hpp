@@ -0,0 +1,245 @@
+// Scheduler keeps the absolute deadlines of every tick, report and callback
+// in a min-heap, so the next event can be found without scanning every sensor
+
+//  A header guard prevents the file from being included twice
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include "check.hpp"
+
+namespace Sensor {
+    //  An event that the scheduler keeps track of
+    struct Event {
+        uint32_t deadline; //  The absolute time (from millis) the event is due
+        uint32_t period;   //  The time between repeats of the event, 0 for a one shot event
+        uint8_t kind;           //  What sort of event it is, events due at the same time run in kind order
+        uint8_t index;          //  Which sensor (or channel) the event belongs to
+    };
+
+    class Scheduler {
+    private:
+        int maxEvents;      //  The max number of events that can be added
+        int eventCount;     //  The number of events that have been added
+        int heapSize;       //  The number of events currently scheduled
+
+        Event* events;      //  The events, indexed by their handle
+        int* heap;          //  The handles of the scheduled events, ordered as a min-heap on deadline
+        int* positions;     //  The position of each handle in the heap, -1 if it isn't scheduled
+
+        uint32_t missedDeadlines;  //  The number of deadlines skipped because they were already a whole period late
+
+        bool before(int a, int b);
+        void swap(int i, int j);
+        void siftUp(int i);
+        void siftDown(int i);
+        void remove(int i);
+        unsigned int dueMask(int i, uint32_t now, const uint16_t* masks);
+    public:
+        Scheduler(int maxEvents);
+        ~Scheduler();
+        int add(uint8_t kind, uint8_t index, uint32_t period, uint32_t deadline);
+        void schedule(int handle, uint32_t deadline);
+        void cancel(int handle);
+        void setPeriod(int handle, uint32_t period);
+        uint32_t advance(int handle, uint32_t now);
+        bool isScheduled(int handle);
+        Event& getEvent(int handle);
+        int next();
+        long timeUntilNext(uint32_t now);
+        unsigned int dueMask(uint32_t now, const uint16_t* masks);
+        int getMaxEvents();
+        uint32_t getMissedDeadlines();
+    };
+
+    uint32_t advanceDeadline(uint32_t deadline, uint32_t period, uint32_t now, uint32_t& skipped) {
+        //  The next deadline is kept relative to the last one rather than to now,
+        //  so lateness in processing doesn't build up as drift
+        deadline += period;
+        skipped = 0;
+        uint32_t late = now - deadline;
+        if ((int32_t)late >= (int32_t)period) {
+            //  If a whole period has already been missed, skip the missed deadlines
+            //  but keep to the same phase, so the event runs at most once to catch up
+            skipped = late / period;
+            deadline += skipped * period;
+        }
+        return deadline;
+    }
+
+    Scheduler::Scheduler(int max) {
+        maxEvents = max;
+        eventCount = 0;
+        heapSize = 0;
+        missedDeadlines = 0;
+
+        //  Allocates memory for the events and the heap that orders them
+        events = (Event*)malloc(sizeof(Event) * maxEvents);
+        heap = (int*)malloc(sizeof(int) * maxEvents);
+        positions = (int*)malloc(sizeof(int) * maxEvents);
+    }
+
+    Scheduler::~Scheduler() {
+        //  Free the memory for the arrays when the scheduler is destroyed
+        free(events);
+        free(heap);
+        free(positions);
+    }
+
+    bool Scheduler::before(int a, int b) {
+        //  Compares the deadlines by their difference rather than their value,
+        //  so the order stays correct when millis() wraps around
+        long difference = (int32_t)(events[a].deadline - events[b].deadline);
+        if (difference != 0) {
+            return difference < 0;
+        }
+        //  Events due at the same time run in kind order (ticks before reports before callbacks)
+        return events[a].kind < events[b].kind;
+    }
+
+    void Scheduler::swap(int i, int j) {
+        //  Swaps two entries in the heap and keeps track of where they moved to
+        int handle = heap[i];
+        heap[i] = heap[j];
+        heap[j] = handle;
+        positions[heap[i]] = i;
+        positions[heap[j]] = j;
+    }
+
+    void Scheduler::siftUp(int i) {
+        //  Moves an entry up the heap until its parent is due before it
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (!before(heap[i], heap[parent])) break;
+            swap(i, parent);
+            i = parent;
+        }
+    }
+
+    void Scheduler::siftDown(int i) {
+        //  Moves an entry down the heap until both of its children are due after it
+        while (true) {
+            int first = i;
+            int left = 2 * i + 1;
+            int right = left + 1;
+            if (left < heapSize && before(heap[left], heap[first])) first = left;
+            if (right < heapSize && before(heap[right], heap[first])) first = right;
+            if (first == i) break;
+            swap(i, first);
+            i = first;
+        }
+    }
+
+    void Scheduler::remove(int i) {
+        //  Takes the entry at position i out of the heap, filling the gap with the last entry
+        int handle = heap[i];
+        heapSize--;
+        if (i != heapSize) {
+            swap(i, heapSize);
+            siftDown(i);
+            siftUp(i);
+        }
+        positions[handle] = -1;
+    }
+
+    int Scheduler::add(uint8_t kind, uint8_t index, uint32_t period, uint32_t deadline) {
+        //  Adds a new event and schedules it, returning the handle used to refer to it
+        if (eventCount >= maxEvents) {
+            RAISE(ERR_TOO_MANY_EVENTS);
+            return -1;
+        }
+        int handle = eventCount;
+        eventCount++;
+
+        events[handle].kind = kind;
+        events[handle].index = index;
+        events[handle].period = period;
+        positions[handle] = -1;
+        schedule(handle, deadline);
+        return handle;
+    }
+
+    void Scheduler::schedule(int handle, uint32_t deadline) {
+        //  Sets the deadline of an event, adding it to the heap if it isn't already there
+        events[handle].deadline = deadline;
+        int i = positions[handle];
+        if (i < 0) {
+            i = heapSize;
+            heapSize++;
+            heap[i] = handle;
+            positions[handle] = i;
+            siftUp(i);
+        } else {
+            siftDown(i);
+            siftUp(i);
+        }
+    }
+
+    void Scheduler::cancel(int handle) {
+        //  Takes an event out of the heap, it can be scheduled again later
+        if (positions[handle] >= 0) {
+            remove(positions[handle]);
+        }
+    }
+
+    void Scheduler::setPeriod(int handle, uint32_t period) {
+        //  The new period is used from the next time the event is advanced
+        events[handle].period = period;
+    }
+
+    uint32_t Scheduler::advance(int handle, uint32_t now) {
+        //  Called once an event has been processed, to move it on to its next deadline
+        //  Returns the number of deadlines that had to be skipped
+        Event& event = events[handle];
+        if (event.period == 0) {
+            //  One shot events are done once they have run
+            cancel(handle);
+            return 0;
+        }
+
+        uint32_t skipped;
+        schedule(handle, advanceDeadline(event.deadline, event.period, now, skipped));
+        missedDeadlines += skipped;
+        return skipped;
+    }
+
+    bool Scheduler::isScheduled(int handle) {
+        return handle >= 0 && positions[handle] >= 0;
+    }
+
+    Event& Scheduler::getEvent(int handle) {
+        return events[handle];
+    }
+
+    int Scheduler::next() {
+        //  The handle of the next event due, or -1 if nothing is scheduled
+        if (heapSize == 0) return -1;
+        return heap[0];
+    }
+
+    long Scheduler::timeUntilNext(uint32_t now) {
+        //  The time until the next event is due, negative if it is already late
+        //  time is 1 sec by default
+        if (heapSize == 0) return 1000;
+        return (int32_t)(events[heap[0]].deadline - now);
+    }
+
+    unsigned int Scheduler::dueMask(int i, uint32_t now, const uint16_t* masks) {
+        //  An entry can only be due if its parent is, so the search stops at the first entry that isn't
+        if (i >= heapSize || (int32_t)(events[heap[i]].deadline - now) > 0) return 0;
+        return masks[heap[i]] | dueMask(2 * i + 1, now, masks) | dueMask(2 * i + 2, now, masks);
+    }
+
+    unsigned int Scheduler::dueMask(uint32_t now, const uint16_t* masks) {
+        //  Combines a mask (indexed by handle) for every event that is due, without taking them off the heap
+        return dueMask(0, now, masks);
+    }
+
+    int Scheduler::getMaxEvents() {
+        return maxEvents;
+    }
+
+    uint32_t Scheduler::getMissedDeadlines() {
+        return missedDeadlines;
+    }
+}
+
+#endif
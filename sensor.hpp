@@ -3,13 +3,36 @@
 #ifndef SENSOR_H
 #define SENSOR_H
 #include "check.hpp"
+#include "acquisition.hpp"
+#include "filter.hpp"
+#include "calibration.hpp"
+#include "telemetryFormat.hpp"
+
+//  How often a reading in progress is checked once it should have finished, in milliseconds
+#define ASYNC_POLL_INTERVAL 1
+
+//  How long after it should have finished a reading is given up on, in milliseconds
+#define ASYNC_TIMEOUT 100
 
 namespace Sensor {
+    class AsyncSensor;
+
+    //  Defines a report callback function type, used by the sensor managers to pass readings back
+    typedef void (* ReportCallback)(double*);
+    //  Defines a change callback function type, passed the readings and a bitmap of the ones to use,
+    //  used for on change reporting and by subscribers
+    typedef void (* ChangeCallback)(double*, uint32_t);
+
     class Sensor {
     private:
         //  The rates in milliseconds at which the tick and report functions should be called
         int tickRate = -1;
         int reportRate = -1;
+    protected:
+        //  An optional filter for the samples taken on ticks, which reports then read from
+        Filter* filter = NULL;
+        //  An optional lookup table that converts readings, in place of the sensor's own conversion
+        Calibration* calibration = NULL;
     public:
         Sensor() {}
         ~Sensor() {}
@@ -17,15 +40,73 @@ namespace Sensor {
         //  Tick and report are virtual, so they must be implemented by classes that inherit from sensor
         virtual void tick() = 0;
         virtual double report() = 0;
+        //  Attach is optional, sensors that read pins add them to the acquisition here
+        //  so the sensor manager can read them in one pass
+        virtual void attach(Acquisition& acquisition) {}
+        //  Sensors whose readings take a while return themselves here, see AsyncSensor
+        virtual AsyncSensor* getAsync() { return NULL; }
+        //  Sensors that report more than one value say how many here, the count mustn't change once added to the manager
+        virtual uint8_t getValueCount() { return 1; }
+        //  Writes the values straight into the sensor manager's readings, by default just the report
+        virtual void reportValues(double* values) { values[0] = report(); }
+        //  The decimal places each value keeps in telemetry frames, sensors whose values are too big for the default
+        //  keep fewer, and the program can still change them through the sensor manager's telemetry once it is added
+        virtual uint8_t getDecimals(uint8_t value) { return TELEMETRY_DEFAULT_DECIMALS; }
+        void attachFilter(Filter* newFilter);
+        Filter* getFilter();
+        void setCalibration(Calibration* newCalibration);
         void setTickRate(int tickRate);
         int getTickRate();
         void setReportRate(int reportRate);
         int getReportRate();
     };
 
+    //  A sensor on a bus or with a slow conversion, whose reading is started, then collected once it is ready,
+    //  so the sensor manager can keep ticking the other sensors while it waits
+    //  The manager starts it on each report, checks it once the conversion time has passed, and collects it when it is ready
+    class AsyncSensor : public Sensor {
+    public:
+        virtual bool start() = 0;       //  Starts a reading, returns false if it couldn't be started
+        virtual bool poll() = 0;        //  Whether the reading is ready, must return straight away
+        virtual double collect() = 0;   //  Takes the reading once it is ready
+        //  How long a reading usually takes in milliseconds, so it isn't checked before it could be ready
+        virtual unsigned int getConversionTime() { return 0; }
+        double report();
+        AsyncSensor* getAsync() { return this; }
+    };
+
+    double AsyncSensor::report() {
+        //  Waits for a whole reading, for when the sensor is used without the sensor manager
+        if (!start()) return NAN;
+        uint32_t started = millis();
+        while (!poll()) {
+            if (millis() - started >= getConversionTime() + ASYNC_TIMEOUT) {
+                RAISE(ERR_ASYNC_TIMEOUT);
+                return NAN;
+            }
+        }
+        return collect();
+    }
+
+    void Sensor::attachFilter(Filter* newFilter) {
+        //  The sensor needs a tick rate for the filter to get any samples
+        //  Attaching NULL goes back to reporting unfiltered readings
+        filter = newFilter;
+        if (filter != NULL) filter->reset();
+    }
+
+    Filter* Sensor::getFilter() {
+        return filter;
+    }
+
+    void Sensor::setCalibration(Calibration* newCalibration) {
+        //  Setting NULL goes back to the sensor's own conversion
+        calibration = newCalibration;
+    }
+
     void Sensor::setTickRate(int newTickRate) {
-        CHECK(newTickRate >= 1, "Tick rate must be at least 1 millisecond")
-        CHECK(tickRate == -1, "Tick rate already set")
+        CHECK(newTickRate >= 1, ERR_TICK_RATE_TOO_LOW)
+        CHECK(tickRate == -1, ERR_TICK_RATE_ALREADY_SET)
         tickRate = newTickRate;
     }
 
@@ -34,8 +115,8 @@ namespace Sensor {
     }
 
     void Sensor::setReportRate(int newReportRate) {
-        CHECK(newReportRate >= 1, "Read rate must be at least 1 millisecond")
-        CHECK(reportRate == -1, "Read rate already set")
+        CHECK(newReportRate >= 1, ERR_REPORT_RATE_TOO_LOW)
+        CHECK(reportRate == -1, ERR_REPORT_RATE_ALREADY_SET)
         reportRate = newReportRate;
     }
 
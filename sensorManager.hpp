@@ -6,171 +6,603 @@
 #ifndef SENSOR_MANAGER_H
 #define SENSOR_MANAGER_H
 #include "sensor.hpp"
+#include "scheduler.hpp"
+#include "indicator.hpp"
+#include "telemetry.hpp"
+#include "snapshot.hpp"
+#include "pushButton.hpp"
+#include "logger.hpp"
+#include "idle.hpp"
+#ifdef SENSOR_STATS
+#include "stats.hpp"
+#endif
+
+//  The max number of subscribers, can be defined before the sensor manager is included to change it
+#ifndef SENSOR_MAX_SUBSCRIBERS
+#define SENSOR_MAX_SUBSCRIBERS 4
+#endif
 
 namespace Sensor {
-    //  Defines a report callback function type
-    typedef void (* ReportCallback)(double*);
-    typedef void (* SendLEDCommand) (int, int);
+    //  The kinds of event the sensor manager schedules, in the order they run when due at the same time
+    enum EventKind {
+        TICK_EVENT,
+        REPORT_EVENT,
+        COLLECT_EVENT,
+        CALLBACK_EVENT,
+        SUBSCRIPTION_EVENT,
+        INDICATOR_EVENT
+    };
 
     class SensorManager {
+        static_assert(SENSOR_MAX_SUBSCRIBERS >= 1 && SENSOR_MAX_SUBSCRIBERS <= 16, "There can be from 1 to 16 subscribers");
     private:
+        //  A callback that wants some of the readings at its own rate
+        struct Subscription {
+            ChangeCallback callback;    //  The function passed the readings, NULL if the slot is free
+            uint32_t channels;          //  The sensors it wants readings from
+            int event;                  //  The scheduler handle that times it
+        };
+
+        //  A sensor whose report rate follows how fast its reading is changing
+        struct AdaptiveRate {
+            int fastest;        //  The shortest report period, in milliseconds, 0 if the rate is fixed
+            int slowest;        //  The longest report period
+            int period;         //  The report period now
+            double threshold;   //  How fast the reading has to change (units a second) to report as fast as possible
+            double lastReading; //  The reading at the last report
+            uint32_t lastTime;     //  When the last report was
+            uint32_t interval;     //  The average time between reports, in 1/16 milliseconds
+        };
+
         int sensorCount;    //  The number of sensors in use
         int maxSensorCount; //  The max number of sensors in use
+        int valueCount;     //  The number of readings the sensors in use report
+        int maxValueCount;  //  The max number of readings, each sensor reports one or more
 
         Sensor** sensors;   //  An array of sensor objects
-        int* nextTicks;     //  The times for the next tick call on each sensor object
-        int* nextReports;   //  The times for the next report call on each sensor object
-        double* readings;   //  The last reading from each sensor
+        int* tickEvents;    //  The scheduler handles for the tick call on each sensor object
+        int* reportEvents;  //  The scheduler handles for the report call on each sensor object
+        int* collectEvents; //  The scheduler handles that check on readings in progress, for async sensors
+        uint32_t* collectStarts;   //  When each async sensor's reading in progress was started
+        AdaptiveRate* adaptiveRates;    //  The adaptive rate of each sensor
+        int* valueOffsets;  //  Where each sensor's readings start, sensors reporting several values take that many channels
+        Snapshot readings;  //  The last readings from every sensor, published a pass at a time
+
+        Acquisition acquisition;    //  Reads the inputs of every sensor due at the same time in one pass
+        uint16_t* eventMasks;       //  The acquisition channels each scheduled event needs, indexed by handle
 
+        Scheduler scheduler;    //  Keeps the deadlines of every tick, report and callback in order
         int callbackRate;   //  The rate at which the callback function should pass sensor readings back to the program
-        int nextCallback;   //  The time for the next callback
-        unsigned long prevTime; //  The time of the last thing (tick, report, callback)
-        int spinTime;       //  The time to run the sensor manager for
+        int callbackEvent;  //  The scheduler handle for the callback
 
+        PushButton* diagButton = NULL;  //  The button that turns diagnostic mode on and off with a long press
         int diagTimer = 0;
         bool diagMode = 0;
         int faultMode = sensorCount + 2;
         int faultTimer = 0;
 
         ReportCallback reportCallback;  //  The callback function that passes sensor readings back to the program
-        SendLEDCommand sendLEDCommand;
+        Indicators indicators;          //  Drives the status LEDs without blocking
+        Telemetry telemetry;            //  Packs the readings into binary frames
+        FrameCallback frameCallback;    //  The callback function that passes the frames back to the program
+        uint8_t* frame;     //  The buffer the frames for the frame callback are encoded into
+        int frameSize;      //  The size of the frame buffer
+        Logger* logger;     //  Stores the frames, written out in idle time
+        Logger* captureLogger;  //  Stores the recorder's raw inputs, written out in idle time as well
+        IdleStrategy* idleStrategy; //  How spin waits for the next event
+
+        ChangeCallback changeCallback;  //  The callback function that passes the readings and which changed back to the program
+        bool onChange;      //  Whether callbacks only send the readings that changed
+        double* deadbands;  //  How far each reading has to move from the one last sent to count as a change
+        uint32_t* maxSilences; //  The longest each reading can go without being sent, 0 for no limit
+        double* sentReadings;       //  The reading last sent for each sensor
+        uint32_t* sentTimes;   //  When each reading was last sent
+        uint32_t keyframeInterval; //  How often every reading is sent whether it changed or not, 0 for never
+        uint32_t lastKeyframe;     //  When every reading was last sent
+        bool keyframePending;           //  Whether the next callback sends every reading
+
+        uint32_t alignedChannels;   //  The readings moved to the same instant before the callbacks get them
+        double* priorReadings;      //  The reading before the last one on each channel, which aligning interpolates from
+        uint32_t* priorTimes;  //  When it was captured (micros)
+        double* aligned;            //  The aligned readings the callbacks are passed
+        uint32_t alignedTime;  //  The instant they were aligned to (micros)
+
+        Subscription subscriptions[SENSOR_MAX_SUBSCRIBERS];
+        uint32_t startTime;    //  When the manager was created, subscriptions are timed from it so their deadlines line up
+
+#ifdef SENSOR_STATS
+        SensorStats* stats;         //  The timing of each sensor
+        TimingStats callbackStats;  //  How long each callback takes
+        uint32_t statsStart;   //  When the statistics were last reset (micros)
+        uint32_t idleTime;     //  The time spin has spent waiting since then (micros)
+        uint32_t sleepTime;    //  The part of that the CPU was asleep for (micros)
+        void recordStats(Event& event, uint32_t skipped, uint32_t late, uint32_t cost);
+#endif
 
         void tempCheck(double*);
         void diagCheck();
+        void processButton();
         void faultInject();
-        void updateTimes();
-        void processTicks();
-        void processReports();
+        void processEvents(uint32_t now);
         void processCallbacks();
+        void startReading(int sensorIndex, AsyncSensor* sensor, uint32_t now);
+        void collectReading(int sensorIndex, uint32_t now);
+        void storeReadings(int sensorIndex, uint32_t now);
+        void storeReading(int sensorIndex, double reading, uint32_t now);
+        void adaptRate(int sensorIndex, double reading, uint32_t now);
+        uint32_t changedChannels(double* current, uint32_t now);
+        bool writeLog(Logger* log, long minTime);
+        void keepPrior(int first, int number);
+        double* alignReadings();
+        void processSubscriptions(uint16_t due);
 
     public:
-        SensorManager(int maxSensors, int rate);
+        SensorManager(int maxSensors, int rate, int maxValues = 0);
         ~SensorManager();
         void setReportCallback(ReportCallback callback);
+        void setFrameCallback(FrameCallback callback);
+        void setChangeCallback(ChangeCallback callback);
+        void setLogger(Logger* frameLogger);
+        void setCaptureLogger(Logger* recordLogger);
+        void setIdleStrategy(IdleStrategy* strategy);
+        void setDiagButton(PushButton* button);
+        void setOnChange(bool enabled, uint32_t keyframeTime = 0);
+        void setDeadband(int channel, double deadband, uint32_t maxSilence = 0);
+        void setAdaptiveRate(int sensorIndex, int fastest, int slowest, double threshold);
+        void setAligned(uint32_t channels);
+        uint32_t getAlignedTime();
+        uint32_t getCaptureTime(int channel);
+        int getReportPeriod(int sensorIndex);
+        double getAchievedRate(int sensorIndex);
+        int subscribe(int rate, uint32_t channels, ChangeCallback callback);
+        void unsubscribe(int subscriber);
         void setSendLEDCommand(SendLEDCommand command);
+        Indicators& getIndicators();
+        Telemetry& getTelemetry();
+        int encodeFrame(uint8_t* buffer, int size, uint32_t channels = 0xFFFFFFFF);
         void addSensor(Sensor* sensor);
         void spin(int maxTime = -1);
         int timeToNextTick();
         int timeToNextReport();
         double getLastReport(int sensorIndex);
         double getLastReport(Sensor* sensor);
+        int getValueOffset(int sensorIndex);
+        int getValueCount(int sensorIndex);
+#ifdef SENSOR_STATS
+        SensorStats& getStats(int sensorIndex);
+        TimingStats& getCallbackStats();
+        uint32_t getIdleTime();
+        uint32_t getSleepTime();
+        double getBusyRatio();
+        void resetStats();
+        void dumpStats(ReportCallback callback);
+#endif
     };
 
 
-    SensorManager::SensorManager(int maxSensors, int rate) {
+    SensorManager::SensorManager(int maxSensors, int rate, int maxValues) :
+        readings(maxValues > maxSensors ? maxValues : maxSensors), scheduler(maxSensors * 3 + 1 + SENSOR_MAX_SUBSCRIBERS + INDICATOR_COUNT) {
         //  Sensor count starts at 0
         sensorCount = 0;
         maxSensorCount = maxSensors;
+        //  The readings have room for one value from each sensor, or max values if that is more
+        valueCount = 0;
+        maxValueCount = maxValues > maxSensors ? maxValues : maxSensors;
 
         //  Allocates memory for arrays for the sensors
-        //  as well as the times and readings
+        //  as well as the event handles
         sensors = (Sensor**)malloc(sizeof(Sensor*) * maxSensors);
-        nextTicks = (int*)malloc(sizeof(int) * maxSensors);
-        nextReports = (int*)malloc(sizeof(int) * maxSensors);
-        readings = (double*)malloc(sizeof(double) * maxSensors);
+        tickEvents = (int*)malloc(sizeof(int) * maxSensors);
+        reportEvents = (int*)malloc(sizeof(int) * maxSensors);
+        collectEvents = (int*)malloc(sizeof(int) * maxSensors);
+        collectStarts = (uint32_t*)malloc(sizeof(uint32_t) * maxSensors);
+        adaptiveRates = (AdaptiveRate*)malloc(sizeof(AdaptiveRate) * maxSensors);
+        valueOffsets = (int*)malloc(sizeof(int) * maxSensors);
+        eventMasks = (uint16_t*)malloc(sizeof(uint16_t) * scheduler.getMaxEvents());
+        frameSize = TELEMETRY_FRAME_SIZE(maxValueCount < TELEMETRY_MAX_CHANNELS ? maxValueCount : TELEMETRY_MAX_CHANNELS);
+        frame = (uint8_t*)malloc(frameSize);
+        deadbands = (double*)malloc(sizeof(double) * maxValueCount);
+        maxSilences = (uint32_t*)malloc(sizeof(uint32_t) * maxValueCount);
+        sentReadings = (double*)malloc(sizeof(double) * maxValueCount);
+        sentTimes = (uint32_t*)malloc(sizeof(uint32_t) * maxValueCount);
+        priorReadings = (double*)malloc(sizeof(double) * maxValueCount);
+        priorTimes = (uint32_t*)malloc(sizeof(uint32_t) * maxValueCount);
+        aligned = (double*)malloc(sizeof(double) * maxValueCount);
+        for (int i = 0; i < maxValueCount; i++) {
+            deadbands[i] = 0;   //  Any change is sent by default
+            maxSilences[i] = 0;
+            sentReadings[i] = 0;
+            sentTimes[i] = 0;
+            priorReadings[i] = 0;
+            priorTimes[i] = 0;  //  No reading yet
+        }
+        for (int i = 0; i < maxSensors; i++) {
+            adaptiveRates[i].fastest = 0;   //  Rates are fixed by default
+            valueOffsets[i] = i;    //  Until the sensor is added
+        }
+        for (int i = 0; i < scheduler.getMaxEvents(); i++) {
+            eventMasks[i] = 0;  //  Callbacks and indicators don't need any channels
+        }
+#ifdef SENSOR_STATS
+        stats = (SensorStats*)malloc(sizeof(SensorStats) * maxSensors);
+        resetStats();
+#endif
 
         callbackRate = rate;            //  Stores the callback rate
-        nextCallback = callbackRate;    //  Resets the next callback time
+        //  Schedules the first callback one callback period from now
+        startTime = millis();
+        callbackEvent = scheduler.add(CALLBACK_EVENT, 0, callbackRate, startTime + callbackRate);
+        indicators.begin(&scheduler, INDICATOR_EVENT);
 
-        prevTime = millis();            //  Stores the current time
+        //  Adds an event for each subscription slot, which is only scheduled while the slot is in use
+        for (int i = 0; i < SENSOR_MAX_SUBSCRIBERS; i++) {
+            subscriptions[i].callback = NULL;
+            subscriptions[i].channels = 0;
+            subscriptions[i].event = scheduler.add(SUBSCRIPTION_EVENT, i, 0, startTime);
+            scheduler.cancel(subscriptions[i].event);
+        }
 
-        spinTime = 0;
         reportCallback = NULL;
+        frameCallback = NULL;
+        logger = NULL;
+        captureLogger = NULL;
+        idleStrategy = &sleepIdle;
+        changeCallback = NULL;
+        onChange = false;
+        keyframeInterval = 0;
+        lastKeyframe = 0;
+        keyframePending = true;
+        alignedChannels = 0;
+        alignedTime = 0;
     }
 
 
     SensorManager::~SensorManager() {
         //  Free the memory for the arrays when the sensor manager is destroyed
         free(sensors);
-        free(nextTicks);
-        free(nextReports);
-        free(readings);
+        free(tickEvents);
+        free(reportEvents);
+        free(collectEvents);
+        free(collectStarts);
+        free(adaptiveRates);
+        free(valueOffsets);
+        free(eventMasks);
+        free(frame);
+        free(deadbands);
+        free(maxSilences);
+        free(sentReadings);
+        free(sentTimes);
+        free(priorReadings);
+        free(priorTimes);
+        free(aligned);
+#ifdef SENSOR_STATS
+        free(stats);
+#endif
     }
 
-    void SensorManager::updateTimes() {
-        //  Calculate the time since the last update
-        unsigned long time = millis();
-        int timeDelta = time - prevTime;
+    void SensorManager::processEvents(uint32_t now) {
+        //  Read every input the due ticks and reports need in one pass,
+        //  so they all convert readings taken at the same instant
+        uint16_t channels = scheduler.dueMask(now, eventMasks);
+        if (channels != 0) {
+            acquisition.scan(channels);
+        }
 
-        //  Update the time
-        prevTime = time;
+        //  The subscribers that are due, they are called once every other due event has run
+        uint16_t dueSubscriptions = 0;
 
-        //  Subtract the elapsed time from all of the next tick/report times
-        for (int i = 0; i < sensorCount; i++) {
-            nextTicks[i] -= timeDelta;
-            nextReports[i] -= timeDelta;
+        //  Keep taking the earliest event off the scheduler until none are due
+        while (scheduler.next() >= 0 && scheduler.timeUntilNext(now) <= 0) {
+            int handle = scheduler.next();
+            Event event = scheduler.getEvent(handle);
+
+            //  Move the event on to its next deadline first, so the event can reschedule itself
+#ifdef SENSOR_STATS
+            uint32_t skipped = scheduler.advance(handle, now);
+            uint32_t late = millis() - event.deadline;
+            uint32_t startTime = micros();
+#else
+            scheduler.advance(handle, now);
+#endif
+
+            if (event.kind == TICK_EVENT) {
+                //  Call the tick method
+                sensors[event.index]->tick();
+            } else if (event.kind == REPORT_EVENT) {
+                //  Have the sensor report its readings, they are published at the end of the pass
+                //  Async sensors only start their reading here, it is stored once it is collected
+                AsyncSensor* async = sensors[event.index]->getAsync();
+                if (async != NULL) {
+                    startReading(event.index, async, now);
+                } else {
+                    storeReadings(event.index, now);
+                }
+            } else if (event.kind == COLLECT_EVENT) {
+                collectReading(event.index, now);
+            } else if (event.kind == CALLBACK_EVENT) {
+                processCallbacks();
+            } else if (event.kind == SUBSCRIPTION_EVENT) {
+                dueSubscriptions |= 1 << event.index;
+            } else {
+                indicators.process(event.index, event.deadline);
+            }
+
+#ifdef SENSOR_STATS
+            recordStats(event, skipped, late, micros() - startTime);
+#endif
+        }
+
+        //  The diagnostic button's events are handled as soon as they are seen, not on the next callback
+        if (diagButton != NULL) {
+            processButton();
+        }
+
+        //  Publish the pass's readings all at once, so readers never see some of them without the rest
+        readings.publish();
+
+        if (dueSubscriptions != 0) {
+            processSubscriptions(dueSubscriptions);
         }
-        nextCallback -= timeDelta; //  Subtract the elapsed time from the next callback time
-        spinTime -= timeDelta; //  Subtract the elapsed time from the spin time
     }
 
-    void SensorManager::processTicks() {
-        //  Go through each sensor
-        for (int i = 0; i < sensorCount; i++) {
-            //  If the next tick time has elapsed
-            if (nextTicks[i] <= 0) {
-                //  Call the tick method
-                sensors[i]->tick();
-                //  Reset the next tick time
-                nextTicks[i] = sensors[i]->getTickRate();
+    void SensorManager::startReading(int sensorIndex, AsyncSensor* sensor, uint32_t now) {
+        //  Starts an async sensor's reading, and checks back once it should be ready
+        //  A report that comes round while the last reading is still in progress is skipped
+        if (scheduler.isScheduled(collectEvents[sensorIndex])) return;
+        if (!sensor->start()) return;   //  e.g. the bus is busy, try again on the next report
+        collectStarts[sensorIndex] = now;
+        scheduler.schedule(collectEvents[sensorIndex], now + sensor->getConversionTime());
+    }
+
+    void SensorManager::collectReading(int sensorIndex, uint32_t now) {
+        //  Stores an async sensor's reading if it is ready, otherwise checks again shortly
+        AsyncSensor* sensor = sensors[sensorIndex]->getAsync();
+        if (sensor->poll()) {
+            storeReading(sensorIndex, sensor->collect(), now);
+        } else if (now - collectStarts[sensorIndex] >= sensor->getConversionTime() + ASYNC_TIMEOUT) {
+            //  Give up on it, the last reading stays until the next one works
+            RAISE_ARG(ERR_ASYNC_TIMEOUT, sensorIndex);
+        } else {
+            scheduler.schedule(collectEvents[sensorIndex], now + ASYNC_POLL_INTERVAL);
+        }
+    }
+
+    void SensorManager::storeReadings(int sensorIndex, uint32_t now) {
+        //  The sensor writes its values straight into the readings, to be published at the end of the pass
+        //  They are all stamped with the time the pass scanned the sensor's inputs,
+        //  or the time the sensor was asked for them if it reads its own (e.g. over a bus)
+        int first = valueOffsets[sensorIndex];
+        int number = getValueCount(sensorIndex);
+        keepPrior(first, number);
+        uint32_t captured = eventMasks[reportEvents[sensorIndex]] != 0 ? acquisition.getTimestamp() : micros();
+        double* values = readings.write(first, number, captured);
+        if (values == NULL) return;
+        sensors[sensorIndex]->reportValues(values);
+        //  The rate follows the first value, which is the sensor's report
+        if (adaptiveRates[sensorIndex].fastest > 0) {
+            adaptRate(sensorIndex, values[0], now);
+        }
+    }
+
+    void SensorManager::storeReading(int sensorIndex, double reading, uint32_t now) {
+        //  Stores a sensor's new reading as its first value, to be published at the end of the pass
+        //  It is stamped with the time it was collected
+        keepPrior(valueOffsets[sensorIndex], 1);
+        readings.set(valueOffsets[sensorIndex], reading, micros());
+        if (adaptiveRates[sensorIndex].fastest > 0) {
+            adaptRate(sensorIndex, reading, now);
+        }
+    }
+
+    void SensorManager::keepPrior(int first, int number) {
+        //  Keeps the last published readings of the aligned channels about to be written, to interpolate from
+        //  A sensor reports at most once a pass, so these are the readings before the new ones
+        double* current = readings.read();
+        uint32_t* times = readings.readTimes();
+        for (int i = first; i < first + number && i < 32; i++) {
+            if (alignedChannels & ((uint32_t)1 << i)) {
+                priorReadings[i] = current[i];
+                priorTimes[i] = times[i];
             }
         }
     }
 
-    void SensorManager::processReports() {
-        //  Go through each sensor
-        for (int i = 0; i < sensorCount; i++) {
-            //  If the next report time has elapsed
-            if (nextReports[i] <= 0) {
-                //  Call the report method and store the returned reading
-                readings[i] = sensors[i]->report();
-                //  And reset the next report time
-                nextReports[i] = sensors[i]->getReportRate();
+    double* SensorManager::alignReadings() {
+        //  Moves each aligned reading to the same instant, the oldest of their latest captures,
+        //  by interpolating between the channel's last two readings, so e.g. voltage times current is the power at one moment
+        //  Aligning to the oldest means every channel has a reading at or after the instant, so none are extrapolated
+        double* current = readings.read();
+        uint32_t* times = readings.readTimes();
+        uint32_t now = micros();
+        uint32_t oldest = 0;   //  How long ago the instant is
+        for (int i = 0; i < valueCount; i++) {
+            aligned[i] = current[i];
+            if (i < 32 && (alignedChannels & ((uint32_t)1 << i)) && times[i] != 0 && now - times[i] > oldest) {
+                oldest = now - times[i];
+            }
+        }
+        alignedTime = now - oldest;
+
+        int count = valueCount < 32 ? valueCount : 32;
+        for (int i = 0; i < count; i++) {
+            if (!(alignedChannels & ((uint32_t)1 << i)) || times[i] == 0 || priorTimes[i] == 0) continue;
+            uint32_t behind = times[i] - alignedTime;  //  How long before the latest reading the instant is
+            uint32_t span = times[i] - priorTimes[i];
+            double prior = priorReadings[i];
+            //  Only NaN isn't equal to itself, a channel with a bad reading isn't interpolated
+            if (behind == 0 || span == 0 || prior != prior || current[i] != current[i]) continue;
+            if (behind >= span) {
+                //  The instant is before both readings, the earlier one is the closest
+                aligned[i] = prior;
+            } else {
+                aligned[i] = current[i] - (current[i] - prior) * behind / span;
             }
         }
+        return aligned;
+    }
+
+    void SensorManager::adaptRate(int sensorIndex, double reading, uint32_t now) {
+        //  Jumps to the fastest rate as soon as the reading changes quickly, so transients aren't missed,
+        //  and backs off by a quarter each report while it is changing less than half as fast
+        AdaptiveRate& rate = adaptiveRates[sensorIndex];
+        uint32_t elapsed = now - rate.lastTime;
+        if (elapsed == 0) elapsed = 1;
+        double change = fabs(reading - rate.lastReading) * 1000.0 / elapsed;
+
+        //  Keep track of the rate actually achieved, which async readings and a busy loop can slow down
+        rate.interval += ((long)(elapsed * 16) - (long)rate.interval) / 8;
+        rate.lastReading = reading;
+        rate.lastTime = now;
+
+        int period = rate.period;
+        if (change >= rate.threshold || reading != reading) {
+            period = rate.fastest;
+        } else if (change < rate.threshold / 2) {
+            period += period / 4 + 1;
+            if (period > rate.slowest) period = rate.slowest;
+        }
+        if (period == rate.period) return;
+
+        //  The report event has already moved on to its next deadline, so a faster rate needs it brought forward
+        int event = reportEvents[sensorIndex];
+        scheduler.setPeriod(event, period);
+        if (period < rate.period) {
+            scheduler.schedule(event, now + period);
+        }
+        //  Ticks keep the same number per report, e.g. to fill a filter
+        if (tickEvents[sensorIndex] >= 0) {
+            long tickPeriod = (long)sensors[sensorIndex]->getTickRate() * period / sensors[sensorIndex]->getReportRate();
+            scheduler.setPeriod(tickEvents[sensorIndex], tickPeriod >= 1 ? tickPeriod : 1);
+        }
+        rate.period = period;
+    }
+
+    void SensorManager::processSubscriptions(uint16_t due) {
+        //  Calls every due subscriber with the same readings, after all the reports due by now,
+        //  so subscribers due at the same time see the same snapshot
+#ifdef SENSOR_STATS
+        uint32_t startTime = micros();
+#endif
+        for (int i = 0; i < SENSOR_MAX_SUBSCRIBERS; i++) {
+            if ((due & (1 << i)) && subscriptions[i].callback != NULL) {
+                subscriptions[i].callback(readings.read(), subscriptions[i].channels);
+            }
+        }
+#ifdef SENSOR_STATS
+        callbackStats.add(micros() - startTime);
+#endif
     }
 
     void SensorManager::processCallbacks() {
-        //  If the next callback time has elapsed
-        if (nextCallback <= 0) {
-            //  reset the next callback time
-            nextCallback = callbackRate;
-            tempCheck(readings);
-            diagCheck();
-
-            //  And call the callback function with the array of sensor readings
-            //  to pass the readings back to the main program
-            if (diagMode) {
-                faultInject();
-                sendLEDCommand(1,2);
-            } else {
-                sendLEDCommand(1,1);
+        //  Called by the scheduler whenever the callback time has elapsed
+        //  Publish the reports due with the callback, so it sees them
+        readings.publish();
+        tempCheck(readings.read());
+        diagCheck();
+
+        //  Pulse the heartbeat LED, the scheduler turns it off again
+        //  so sensors keep ticking while the pulse is visible
+        if (diagMode) {
+            faultInject();
+            indicators.pulse(1, 2, 50);
+        } else {
+            indicators.pulse(1, 1, 50);
+        }
+
+        //  A fault injected in diagnostic mode is published before the readings are sent
+        //  The callbacks and frames get the aligned readings if any channels are aligned
+        readings.publish();
+        double* current = alignedChannels != 0 ? alignReadings() : readings.read();
+
+        //  Work out which readings to send, all of them unless only changes are being sent
+        uint32_t channels = valueCount < 32 ? ((uint32_t)1 << valueCount) - 1 : 0xFFFFFFFF;
+        if (onChange) {
+            channels = changedChannels(current, millis());
+        }
+
+        //  And call the callback functions with the array of sensor readings
+        //  and the frame encoded from them to pass the readings back to the main program
+        //  The report callback always gets every reading, the others skip callbacks where nothing changed
+        if (reportCallback != NULL) {
+            reportCallback(current);
+        }
+        if (channels == 0) return;
+        if (changeCallback != NULL) {
+            changeCallback(current, channels);
+        }
+        if (frameCallback != NULL || logger != NULL) {
+            //  The frame is encoded once for both, the logger only copies it, storage is written in idle time
+            int length = telemetry.encode(frame, frameSize, current, valueCount, channels, millis());
+            if (length > 0) {
+                if (frameCallback != NULL) frameCallback(frame, length);
+                if (logger != NULL) logger->log(frame, length);
             }
-            reportCallback(readings);
-            delay(50);
-            sendLEDCommand(1,0);
         }
     }
 
+    uint32_t SensorManager::changedChannels(double* current, uint32_t now) {
+        //  Finds the readings that have moved further than their deadband since they were last sent,
+        //  or have been silent for too long, and marks them as sent
+        //  A keyframe sends every reading, so the program can catch up with changes it missed
+        bool keyframe = keyframePending || (keyframeInterval > 0 && now - lastKeyframe >= keyframeInterval);
+        if (keyframe) {
+            lastKeyframe = now;
+            keyframePending = false;
+        }
+
+        uint32_t channels = 0;
+        int count = valueCount < 32 ? valueCount : 32;
+        for (int i = 0; i < count; i++) {
+            double reading = current[i];
+            double sent = sentReadings[i];
+            //  Only NaN isn't equal to itself, and a reading going to or from NaN is always a change
+            bool changed = keyframe || fabs(reading - sent) > deadbands[i] || (reading != reading) != (sent != sent);
+            if (!changed && maxSilences[i] > 0 && now - sentTimes[i] >= maxSilences[i]) {
+                changed = true;
+            }
+            if (changed) {
+                channels |= (uint32_t)1 << i;
+                sentReadings[i] = reading;
+                sentTimes[i] = now;
+            }
+        }
+        return channels;
+    }
+
     void SensorManager::tempCheck(double* readings) {
-        double motTemp = readings[4];
+        if (sensorCount <= 4) return;   //  No motor temperature sensor yet
+        double motTemp = readings[valueOffsets[4]];
         if (motTemp < 60.0) {
-            sendLEDCommand(2,1);
+            indicators.steady(2,1);
         } else if (motTemp < 90.0) {
-            sendLEDCommand(2,2);
+            indicators.steady(2,2);
         } else {
-            sendLEDCommand(2,3);
+            indicators.steady(2,3);
+        }
+    }
+
+    void SensorManager::processButton() {
+        //  A long press turns diagnostic mode on or off, the LED shows the button is held
+        ButtonEvent event;
+        while (diagButton->getEvent(event)) {
+            if (event.kind == BUTTON_LONG_PRESSED) {
+                diagMode = diagMode ? 0 : 1;
+                faultMode = 2;
+            }
         }
+        indicators.steady(3, diagButton->isPressed() ? 1 : 0);
     }
 
     void SensorManager::diagCheck() {
-            double butOn = sensors[1]->report();
+            //  Without a diagnostic button, the button's reports are checked every callback instead
+            if (diagButton != NULL || sensorCount <= 1) return;
+            double butOn = readings.read()[valueOffsets[1]];  //  The button's last report, rather than reading the pin again
             if (butOn >= 0.5) {
                 diagTimer++;
-                sendLEDCommand(3,1);
+                indicators.steady(3,1);
             } else {
                 diagTimer = 0;
-                sendLEDCommand(3,0);
+                indicators.steady(3,0);
             }
             if (diagTimer >= 10) {
                 diagMode = diagMode ? 0 : 1;
@@ -180,7 +612,10 @@ namespace Sensor {
     }
 
     void SensorManager::faultInject() {
-        readings[faultMode] = 999; // Inject a fault value of 666.6
+        //  Faults go into the sensors from the third on, there are none to inject without them
+        if (faultMode >= sensorCount) faultMode = 2;
+        if (faultMode >= sensorCount) return;
+        readings.set(valueOffsets[faultMode], 999, micros()); // Inject a fault value of 666.6
         faultTimer++;
         if (faultTimer >= 5) {
             if (faultMode >= sensorCount-1) {
@@ -193,76 +628,312 @@ namespace Sensor {
     }
 
     void SensorManager::setReportCallback(ReportCallback callback) {
-        CHECK(reportCallback == NULL, "Report callback already set")
+        CHECK(reportCallback == NULL, ERR_CALLBACK_ALREADY_SET)
         reportCallback = callback;
     }
 
+    void SensorManager::setFrameCallback(FrameCallback callback) {
+        //  The frame callback is passed the readings as a binary telemetry frame,
+        //  ready to write to a serial port, instead of or as well as the report callback
+        CHECK(frameCallback == NULL, ERR_CALLBACK_ALREADY_SET)
+        frameCallback = callback;
+    }
+
+    void SensorManager::setLogger(Logger* frameLogger) {
+        //  The logger is given every frame the frame callback would be, including on change frames
+        logger = frameLogger;
+    }
+
+    void SensorManager::setIdleStrategy(IdleStrategy* strategy) {
+        //  Sleeping until the next event is the default, busy waiting is there for debugging
+        idleStrategy = strategy;
+        acquisition.setAdcSleep(strategy->sleepsForAdc());
+    }
+
+    void SensorManager::setCaptureLogger(Logger* recordLogger) {
+        //  The manager only writes the recorder's blocks out, the recorder is given the same logger to fill, see record.hpp
+        //  It needs its own logger, recordings and frames can't share a stream
+        captureLogger = recordLogger;
+    }
+
+    void SensorManager::setDiagButton(PushButton* button) {
+        //  The manager takes every event from the button, so the program shouldn't take them as well
+        diagButton = button;
+    }
+
+    void SensorManager::setChangeCallback(ChangeCallback callback) {
+        //  The change callback is passed the readings with a bitmap of the sensors to send,
+        //  every sensor each callback unless on change reporting is turned on
+        CHECK(changeCallback == NULL, ERR_CALLBACK_ALREADY_SET)
+        changeCallback = callback;
+    }
+
+    void SensorManager::setOnChange(bool enabled, uint32_t keyframeTime) {
+        //  In on change mode the change and frame callbacks only send the readings that changed,
+        //  with every reading sent first and then every keyframe time (milliseconds, 0 for never)
+        onChange = enabled;
+        keyframeInterval = keyframeTime;
+        keyframePending = true;
+    }
+
+    void SensorManager::setDeadband(int channel, double deadband, uint32_t maxSilence) {
+        //  Sets how far a reading has to move to be sent in on change mode,
+        //  and the longest it can go without being sent anyway (milliseconds, 0 for no limit)
+        //  The channel is the sensor's index, or getValueOffset() plus the value for sensors reporting several
+        if (channel < 0 || channel >= maxValueCount || channel >= 32) {
+            RAISE_ARG(ERR_CHANNEL_OUT_OF_RANGE, channel);
+            return;
+        }
+        deadbands[channel] = deadband;
+        maxSilences[channel] = maxSilence;
+    }
+
+    void SensorManager::setAdaptiveRate(int sensorIndex, int fastest, int slowest, double threshold) {
+        //  Lets a sensor's report period move between fastest and slowest (milliseconds) with how fast its reading changes,
+        //  threshold is the change a second (in the reading's units) that counts as changing quickly
+        //  The sensor must already be added with a report rate, which it starts at, fastest 0 fixes the rate again
+        if (sensorIndex < 0 || sensorIndex >= sensorCount) {
+            RAISE_ARG(ERR_SENSOR_NOT_FOUND, sensorIndex);
+            return;
+        }
+        int event = reportEvents[sensorIndex];
+        if (fastest == 0) {
+            adaptiveRates[sensorIndex].fastest = 0;
+            if (event >= 0) scheduler.setPeriod(event, sensors[sensorIndex]->getReportRate());
+            if (tickEvents[sensorIndex] >= 0) scheduler.setPeriod(tickEvents[sensorIndex], sensors[sensorIndex]->getTickRate());
+            return;
+        }
+        if (event < 0 || fastest < 1 || slowest < fastest) {
+            RAISE_ARG(ERR_ADAPTIVE_RATE_INVALID, sensorIndex);
+            return;
+        }
+        AdaptiveRate& rate = adaptiveRates[sensorIndex];
+        rate.fastest = fastest;
+        rate.slowest = slowest;
+        rate.period = sensors[sensorIndex]->getReportRate();
+        rate.threshold = threshold;
+        rate.lastReading = readings.read()[valueOffsets[sensorIndex]];
+        rate.lastTime = millis();
+        rate.interval = (uint32_t)rate.period * 16;
+    }
+
+    void SensorManager::setAligned(uint32_t channels) {
+        //  Aligns the readings on the channels in the bitmap to the same instant before the report, change
+        //  and frame callbacks get them, 0 turns it off, subscribers always get the readings as captured
+        //  Channels are only interpolated once they have two readings
+        //  Only a channel's last two readings are kept, so aligned channels should report at the same rate:
+        //  a channel reporting faster than the slowest can have both readings after the instant,
+        //  and then gets the earlier of them rather than a value at the instant
+        alignedChannels = channels;
+        for (int i = 0; i < maxValueCount; i++) {
+            priorTimes[i] = 0;
+        }
+    }
+
+    uint32_t SensorManager::getAlignedTime() {
+        //  The instant (micros) the last callback's readings were aligned to
+        return alignedTime;
+    }
+
+    uint32_t SensorManager::getCaptureTime(int channel) {
+        //  When the last reading on the channel was captured (micros), 0 if there hasn't been one,
+        //  safe to call from an interrupt
+        return readings.getTime(channel);
+    }
+
+    int SensorManager::getReportPeriod(int sensorIndex) {
+        //  The report period a sensor is set to now, in milliseconds
+        if (sensorIndex < 0 || sensorIndex >= sensorCount) {
+            RAISE_ARG(ERR_SENSOR_NOT_FOUND, sensorIndex);
+            return 0;
+        }
+        if (adaptiveRates[sensorIndex].fastest > 0) return adaptiveRates[sensorIndex].period;
+        return sensors[sensorIndex]->getReportRate();
+    }
+
+    double SensorManager::getAchievedRate(int sensorIndex) {
+        //  The reports a second an adaptive sensor has actually managed recently, 0 if it isn't adaptive
+        if (sensorIndex < 0 || sensorIndex >= sensorCount) {
+            RAISE_ARG(ERR_SENSOR_NOT_FOUND, sensorIndex);
+            return 0;
+        }
+        if (adaptiveRates[sensorIndex].fastest == 0 || adaptiveRates[sensorIndex].interval == 0) return 0;
+        return 16000.0 / adaptiveRates[sensorIndex].interval;
+    }
+
+    int SensorManager::subscribe(int rate, uint32_t channels, ChangeCallback callback) {
+        //  Adds a callback that is passed the readings every rate milliseconds, with the bitmap
+        //  of the sensors it wants, and returns the subscriber's number, or -1 if there is no room
+        if (rate < 1) {
+            RAISE_ARG(ERR_SUBSCRIPTION_RATE_TOO_LOW, rate);
+            return -1;
+        }
+        for (int i = 0; i < SENSOR_MAX_SUBSCRIBERS; i++) {
+            if (subscriptions[i].callback == NULL) {
+                subscriptions[i].callback = callback;
+                subscriptions[i].channels = channels;
+                //  The first deadline is a whole number of periods from the start,
+                //  so subscribers with rates that divide into each other are due together
+                uint32_t now = millis();
+                scheduler.setPeriod(subscriptions[i].event, rate);
+                scheduler.schedule(subscriptions[i].event, now + rate - (now - startTime) % rate);
+                return i;
+            }
+        }
+        RAISE_ARG(ERR_TOO_MANY_SUBSCRIBERS, SENSOR_MAX_SUBSCRIBERS);
+        return -1;
+    }
+
+    void SensorManager::unsubscribe(int subscriber) {
+        //  Stops calling a subscriber, its slot can be used by the next one
+        if (subscriber < 0 || subscriber >= SENSOR_MAX_SUBSCRIBERS || subscriptions[subscriber].callback == NULL) {
+            RAISE_ARG(ERR_SUBSCRIBER_NOT_FOUND, subscriber);
+            return;
+        }
+        scheduler.cancel(subscriptions[subscriber].event);
+        subscriptions[subscriber].callback = NULL;
+    }
+
     void SensorManager::setSendLEDCommand(SendLEDCommand command) {
-        sendLEDCommand = command;
+        indicators.setSendLEDCommand(command);
+    }
+
+    Indicators& SensorManager::getIndicators() {
+        //  Lets the program show its own pulses and blinks on the LEDs
+        return indicators;
+    }
+
+    Telemetry& SensorManager::getTelemetry() {
+        //  Lets the program set the decimal places each sensor's reading keeps in the frames,
+        //  after the sensor is added, as adding it sets the places it asks for
+        return telemetry;
+    }
+
+    int SensorManager::encodeFrame(uint8_t* buffer, int size, uint32_t channels) {
+        //  Encodes the last readings in the channel bitmap into the buffer, with each reading's index as its channel,
+        //  straight from the readings without copying them
+        //  Returns the length of the frame, or 0 if the buffer is too small
+        return telemetry.encode(buffer, size, readings.read(), valueCount, channels, millis());
     }
 
     void SensorManager::addSensor(Sensor* sensor) {
+        if (sensorCount >= maxSensorCount) {
+            RAISE_ARG(ERR_TOO_MANY_SENSORS, maxSensorCount);
+            return;
+        }
+        //  The sensor's values take the next channels in the readings
+        int values = sensor->getValueCount();
+        if (values < 1 || valueCount + values > maxValueCount) {
+            RAISE_ARG(ERR_TOO_MANY_VALUES, maxValueCount);
+            return;
+        }
+
         //  Adds the sensor to the sensors array
         sensors[sensorCount] = sensor;
-        //  And resets the next tick/report times for it
-        nextTicks[sensorCount] = sensor->getTickRate();
-        nextReports[sensorCount] = sensor->getReportRate();
+        valueOffsets[sensorCount] = valueCount;
+        valueCount += values;
+
+        //  Lets the sensor add its inputs to the acquisition, and finds out which channels they are
+        acquisition.takeAddedMask();
+        sensor->attach(acquisition);
+        uint16_t channels = acquisition.takeAddedMask();
+
+        //  Each value's channel in the telemetry frames keeps the decimal places the sensor asks for
+        for (int i = 0; i < values; i++) {
+            int channel = valueOffsets[sensorCount] + i;
+            if (channel < TELEMETRY_MAX_CHANNELS) telemetry.setDecimals(channel, sensor->getDecimals(i));
+        }
+
+        //  And schedules the first tick/report for it, sensors without a rate are never called
+        uint32_t now = millis();
+        tickEvents[sensorCount] = -1;
+        reportEvents[sensorCount] = -1;
+        collectEvents[sensorCount] = -1;
+        if (sensor->getTickRate() > 0) {
+            tickEvents[sensorCount] = scheduler.add(TICK_EVENT, sensorCount, sensor->getTickRate(), now + sensor->getTickRate());
+            if (tickEvents[sensorCount] >= 0) eventMasks[tickEvents[sensorCount]] = channels;
+        }
+        if (sensor->getReportRate() > 0) {
+            reportEvents[sensorCount] = scheduler.add(REPORT_EVENT, sensorCount, sensor->getReportRate(), now + sensor->getReportRate());
+            if (reportEvents[sensorCount] >= 0) eventMasks[reportEvents[sensorCount]] = channels;
+        }
+        if (sensor->getAsync() != NULL) {
+            //  Only scheduled while a reading is in progress
+            collectEvents[sensorCount] = scheduler.add(COLLECT_EVENT, sensorCount, 0, now);
+            scheduler.cancel(collectEvents[sensorCount]);
+        }
 
         sensorCount++; //  Increments the sensor count
     }
 
-    void SensorManager::spin(int maxTime = -1) {
-        //  Updates the next everything times
-        updateTimes();
-
-        //  Sets the spin time to the max time passed in to the spin function
-        //  spin time is ignored if -1 is passed in
-        spinTime = maxTime;
+    void SensorManager::spin(int maxTime) {
+        //  The time the spin started, spin time is ignored if -1 is passed in
+        uint32_t start = millis();
 
         //  Repeats as long as there is spin time remaining or max time is -1
-        while (spinTime > 0 || maxTime == -1) {
-            //  Finds the minimum time to the next tick/report/callback
-            int minTime = timeToNextTick();
-            int nextReport = timeToNextReport();
+        while (true) {
+            uint32_t now = millis();
 
-            if (nextReport < minTime) {
-                minTime = nextReport;
-            }
+            //  Finds the time to the next tick/report/callback, which is always at the top of the scheduler
+            long minTime = scheduler.timeUntilNext(now);
 
-            if (nextCallback < minTime) {
-                minTime = nextCallback;
+            if (maxTime >= 0) {
+                long spinTime = maxTime - (int32_t)(now - start);
+                if (spinTime <= 0) break;
+                if (spinTime < minTime) {
+                    minTime = spinTime;
+                }
             }
 
-            if (maxTime >= 0 && spinTime < minTime) {
-                minTime = spinTime;
+            //  Writes one of the loggers' full blocks if there is time, then works out the time again
+            //  A failed write waits like normal rather than trying again straight away
+            if (writeLog(logger, minTime) || writeLog(captureLogger, minTime)) {
+                continue;
             }
 
-            //  If the minimum time is greater than 0
+            //  If the minimum time is greater than 0, wait for it the way the idle strategy says
+            //  How late the wait wakes up shows in the lateness of the events
             if (minTime >= 1) {
-                delay(minTime); //  wait
-                //monitor.addWait(minTime); //  Register the wait with the CPU monitor
-                updateTimes(); //  Update the next everything times
+#ifdef SENSOR_STATS
+                uint32_t waitStart = micros();
+                sleepTime += idleStrategy->idle(minTime);
+                idleTime += micros() - waitStart;   //  Register the wait with the statistics
+#else
+                idleStrategy->idle(minTime);
+#endif
+                now = millis();
             }
 
             //  Process any ticks, reports, and callbacks that have happened
-            processTicks();
-            processReports();
-            processCallbacks();
+            processEvents(now);
         }
+    }
 
-
+    bool SensorManager::writeLog(Logger* log, long minTime) {
+        //  Writes one of a logger's full blocks if there is time before the next event,
+        //  so a slow write doesn't usually hold up sensors that are due
+        //  When events are never far enough apart the ring fills, so once the next frame wouldn't fit
+        //  the block is written anyway and the events run late instead
+        //  Returns whether a block was written
+        if (log == NULL || !log->hasFullBlock()) return false;
+        if (minTime < (long)log->getWriteBudget() && !log->isNearlyFull()) return false;
+        return log->writeBlock();
     }
 
     int SensorManager::timeToNextTick() {
+        //  Only used for diagnostics, spin gets the next event straight from the scheduler
         int minTime = 1000; //  time is 1 sec by default
         bool found = false; //  Always set min time if this is the first sensor
+        uint32_t now = millis();
 
         //  Go through all the sensors
         for (int i = 0; i < sensorCount; i++) {
-            if (sensors[i]->getTickRate() > 0) { //  If the sensor has a tick rate
+            if (scheduler.isScheduled(tickEvents[i])) { //  If the sensor has a tick rate
                 //  Set the min time if it is the first sensor or has a lower next tick time
-                if (!found || nextTicks[i] < minTime) {
-                    minTime = nextTicks[i];
+                int time = (int32_t)(scheduler.getEvent(tickEvents[i]).deadline - now);
+                if (!found || time < minTime) {
+                    minTime = time;
+                    found = true;
                 }
             }
         }
@@ -270,17 +941,19 @@ namespace Sensor {
     }
 
     int SensorManager::timeToNextReport() {
-        //  time is 1 sec by default
-        if (sensorCount == 0) return 1000;
-        int minTime = nextReports[0]; //  min time is time to first sensor report
-
-        //  Go through all the other sensors
-        for (int i = 1; i < sensorCount; i++) {
-            //  If the sensor has a report rate
-            if (sensors[i]->getReportRate() > 0) {
-                //  Set the min time if it has a lower next report time
-                if (nextReports[i] < minTime) {
-                    minTime = nextReports[i];
+        //  Only used for diagnostics, spin gets the next event straight from the scheduler
+        int minTime = 1000; //  time is 1 sec by default
+        bool found = false; //  Always set min time if this is the first sensor
+        uint32_t now = millis();
+
+        //  Go through all the sensors
+        for (int i = 0; i < sensorCount; i++) {
+            if (scheduler.isScheduled(reportEvents[i])) { //  If the sensor has a report rate
+                //  Set the min time if it is the first sensor or has a lower next report time
+                int time = (int32_t)(scheduler.getEvent(reportEvents[i]).deadline - now);
+                if (!found || time < minTime) {
+                    minTime = time;
+                    found = true;
                 }
             }
         }
@@ -288,19 +961,138 @@ namespace Sensor {
     }
 
     double SensorManager::getLastReport(int sensorIndex) {
-        //  Returns the last reading from the sensor
-        return readings[sensorIndex];
+        //  Returns the last reading from the sensor, its first value if it reports several, safe to call from an interrupt
+        if (sensorIndex < 0 || sensorIndex >= sensorCount) {
+            RAISE_ARG(ERR_SENSOR_NOT_FOUND, sensorIndex);
+            return 0;
+        }
+        return readings.get(valueOffsets[sensorIndex]);
     }
 
     double SensorManager::getLastReport(Sensor* sensor) {
         //  Finds the sensor and returns its last reading
         for (int i = 0; i < sensorCount; i++) {
             if (sensors[i] == sensor) {
-                return readings[i];
+                return readings.get(valueOffsets[i]);
             }
         }
-        RAISE("Sensor not found.");
+        RAISE(ERR_SENSOR_NOT_FOUND);
+        return 0;
+    }
+
+    int SensorManager::getValueOffset(int sensorIndex) {
+        //  The index of the sensor's first value in the readings, which is also its channel in callbacks and frames
+        if (sensorIndex < 0 || sensorIndex >= sensorCount) {
+            RAISE_ARG(ERR_SENSOR_NOT_FOUND, sensorIndex);
+            return -1;
+        }
+        return valueOffsets[sensorIndex];
+    }
+
+    int SensorManager::getValueCount(int sensorIndex) {
+        //  The number of values the sensor reports, they follow on from its offset
+        if (sensorIndex < 0 || sensorIndex >= sensorCount) {
+            RAISE_ARG(ERR_SENSOR_NOT_FOUND, sensorIndex);
+            return 0;
+        }
+        int end = sensorIndex + 1 < sensorCount ? valueOffsets[sensorIndex + 1] : valueCount;
+        return end - valueOffsets[sensorIndex];
+    }
+
+#ifdef SENSOR_STATS
+    void SensorManager::recordStats(Event& event, uint32_t skipped, uint32_t late, uint32_t cost) {
+        //  Adds the timing of an event that has just been processed to the statistics
+        if (event.kind == TICK_EVENT) {
+            stats[event.index].tick.add(cost);
+        } else if (event.kind == REPORT_EVENT) {
+            stats[event.index].report.add(cost);
+        } else if (event.kind == COLLECT_EVENT) {
+            //  Checks on a reading are part of reporting it, but aren't late by themselves
+            stats[event.index].report.add(cost);
+            return;
+        } else {
+            if (event.kind == CALLBACK_EVENT) {
+                callbackStats.add(cost);
+            }
+            return;
+        }
+        stats[event.index].addLateness(late);
+        stats[event.index].missed += skipped;
+    }
+
+    SensorStats& SensorManager::getStats(int sensorIndex) {
+        return stats[sensorIndex];
+    }
+
+    TimingStats& SensorManager::getCallbackStats() {
+        return callbackStats;
+    }
+
+    uint32_t SensorManager::getIdleTime() {
+        //  The time spin has spent waiting since the statistics were reset, in microseconds
+        return idleTime;
+    }
+
+    uint32_t SensorManager::getSleepTime() {
+        //  The part of the idle time the CPU was asleep for, in microseconds, 0 when busy waiting
+        return sleepTime;
+    }
+
+    double SensorManager::getBusyRatio() {
+        //  The fraction of the time since the statistics were reset that wasn't spent waiting
+        uint32_t elapsed = micros() - statsStart;
+        if (elapsed == 0) return 0;
+        return 1.0 - (double)idleTime / (double)elapsed;
+    }
+
+    void SensorManager::resetStats() {
+        for (int i = 0; i < maxSensorCount; i++) {
+            stats[i].reset();
+        }
+        callbackStats.reset();
+        idleTime = 0;
+        sleepTime = 0;
+        statsStart = micros();
+    }
+
+    void SensorManager::dumpStats(ReportCallback callback) {
+        //  Passes the statistics to a callback, one call of STATS_FIELDS values per sensor:
+        //  index, tick min/mean/max, report min/mean/max (microseconds), max lateness (milliseconds),
+        //  missed deadlines, then the lateness histogram
+        //  Followed by one call for the whole manager:
+        //  -1, callback min/mean/max (microseconds), busy ratio, idle time, elapsed time and sleep time (milliseconds)
+        double values[STATS_FIELDS];
+        for (int i = 0; i < sensorCount; i++) {
+            SensorStats& sensor = stats[i];
+            values[0] = i;
+            values[1] = sensor.tick.count > 0 ? sensor.tick.min : 0;
+            values[2] = sensor.tick.mean();
+            values[3] = sensor.tick.max;
+            values[4] = sensor.report.count > 0 ? sensor.report.min : 0;
+            values[5] = sensor.report.mean();
+            values[6] = sensor.report.max;
+            values[7] = sensor.maxLateness;
+            values[8] = sensor.missed;
+            for (int j = 0; j < LATENESS_BUCKETS; j++) {
+                values[9 + j] = sensor.lateness[j];
+            }
+            callback(values);
+        }
+
+        for (int j = 0; j < STATS_FIELDS; j++) {
+            values[j] = 0;
+        }
+        values[0] = -1;
+        values[1] = callbackStats.count > 0 ? callbackStats.min : 0;
+        values[2] = callbackStats.mean();
+        values[3] = callbackStats.max;
+        values[4] = getBusyRatio();
+        values[5] = idleTime / 1000;
+        values[6] = (micros() - statsStart) / 1000;
+        values[7] = sleepTime / 1000;
+        callback(values);
     }
+#endif
 }
 
 #endif
\ No newline at end of file
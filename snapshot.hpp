@@ -0,0 +1,203 @@
+// Snapshot keeps the sensor manager's readings in three buffers, so whatever reads them always sees
+// a whole set from one pass, never half old and half new values
+//
+// Reports are written into the back buffer, and publishing swaps which buffer is the front one.
+// The buffer that comes back round to be written again is brought up to date with only the readings
+// written in the two passes since it was last published, rather than copying the whole set
+//
+// Readers in the same context as the writer can use the front buffer directly, it can't change under them.
+// Readers that can be interrupted by the writer (e.g. when reports are written from an interrupt)
+// use get() or copy(), which check the sequence number and read again if the buffer was reused part way through
+//
+// Every reading keeps the time it was captured (micros), which is published along with it
+
+//  A header guard prevents the file from being included twice
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "check.hpp"
+
+//  The number of buffers, one being read, one being written and one spare,
+//  so a reader has a whole publish to finish before its buffer is written again
+#define SNAPSHOT_BUFFERS 3
+
+//  Called part way through each read where the writer could interrupt it, does nothing unless a test
+//  defines it before including this, to publish at that point as an interrupt would
+#ifndef SNAPSHOT_READ_HOOK
+#define SNAPSHOT_READ_HOOK()
+#endif
+
+namespace Sensor {
+    class Snapshot {
+    private:
+        double* buffers[SNAPSHOT_BUFFERS];
+        uint32_t* times[SNAPSHOT_BUFFERS];     //  When each reading in the buffer was captured
+        int count;              //  The number of readings in each buffer
+        volatile uint8_t front;     //  The buffer readers see
+        uint8_t back;               //  The buffer reports are written to
+        uint8_t spare;              //  The buffer published before the front one
+        volatile uint8_t sequence;  //  Goes up by one each publish, readers use it to spot their buffer being reused
+        uint32_t written;       //  The readings written since the last publish, readings from 31 up share bit 31
+        uint32_t previous;      //  The readings written in the pass before that
+
+        static uint32_t bit(int index);
+    public:
+        Snapshot(int count);
+        ~Snapshot();
+        void set(int index, double reading, uint32_t time);
+        double* write(int first, int number, uint32_t time);
+        bool publish();
+        double* read();
+        uint32_t* readTimes();
+        double get(int index);
+        uint32_t getTime(int index);
+        void copy(double* destination, int first, int number);
+        uint8_t getSequence();
+    };
+
+    Snapshot::Snapshot(int count) : count(count) {
+        //  Every buffer starts with every reading at 0, captured at time 0
+        for (int i = 0; i < SNAPSHOT_BUFFERS; i++) {
+            buffers[i] = (double*)malloc(sizeof(double) * count);
+            times[i] = (uint32_t*)malloc(sizeof(uint32_t) * count);
+            for (int j = 0; j < count; j++) {
+                buffers[i][j] = 0;
+                times[i][j] = 0;
+            }
+        }
+        front = 0;
+        back = 1;
+        spare = 2;
+        sequence = 0;
+        written = 0;
+        previous = 0;
+    }
+
+    Snapshot::~Snapshot() {
+        for (int i = 0; i < SNAPSHOT_BUFFERS; i++) {
+            free(buffers[i]);
+            free(times[i]);
+        }
+    }
+
+    uint32_t Snapshot::bit(int index) {
+        return index < 31 ? (uint32_t)1 << index : (uint32_t)1 << 31;
+    }
+
+    void Snapshot::set(int index, double reading, uint32_t time) {
+        //  Writes a reading and when it was captured into the back buffer, readers don't see it until the next publish
+        if (index < 0 || index >= count) {
+            RAISE_ARG(ERR_READING_OUT_OF_RANGE, index);
+            return;
+        }
+        buffers[back][index] = reading;
+        times[back][index] = time;
+        written |= bit(index);
+    }
+
+    double* Snapshot::write(int first, int number, uint32_t time) {
+        //  Where several readings captured at the same time can be written into the back buffer in place,
+        //  returns NULL if they don't fit
+        //  Until they are written it still holds the last readings, so the writer can see what they were
+        if (first < 0 || number < 1 || first + number > count) {
+            RAISE_ARG(ERR_READING_OUT_OF_RANGE, first + number - 1);
+            return NULL;
+        }
+        for (int i = first; i < first + number; i++) {
+            times[back][i] = time;
+            written |= bit(i);
+        }
+        return buffers[back] + first;
+    }
+
+    bool Snapshot::publish() {
+        //  Makes the back buffer the front one, returns false if nothing has been written since the last publish
+        if (written == 0) return false;
+
+        uint8_t published = back;
+        back = spare;
+        spare = front;
+        front = published;
+        //  The sequence goes up before the old buffer is written to, so readers part way through it know to read again
+        sequence++;
+
+        //  The new back buffer is two publishes behind, so copy over the readings written since then
+        uint32_t stale = written | previous;
+        double* source = buffers[published];
+        double* destination = buffers[back];
+        for (int i = 0; i < count; i++) {
+            if (stale & bit(i)) {
+                destination[i] = source[i];
+                times[back][i] = times[published][i];
+            }
+        }
+        previous = written;
+        written = 0;
+        return true;
+    }
+
+    double* Snapshot::read() {
+        //  The front buffer, for readers the writer can't interrupt
+        return buffers[front];
+    }
+
+    uint32_t* Snapshot::readTimes() {
+        //  When each reading in the front buffer was captured, for readers the writer can't interrupt
+        return times[front];
+    }
+
+    double Snapshot::get(int index) {
+        //  Reads one reading, safe even if the writer interrupts part way through
+        if (index < 0 || index >= count) {
+            RAISE_ARG(ERR_READING_OUT_OF_RANGE, index);
+            return 0;
+        }
+        uint8_t start;
+        double reading;
+        do {
+            start = sequence;
+            reading = buffers[front][index];
+            SNAPSHOT_READ_HOOK();
+        } while ((uint8_t)(sequence - start) >= SNAPSHOT_BUFFERS - 1);
+        return reading;
+    }
+
+    uint32_t Snapshot::getTime(int index) {
+        //  When one reading was captured, safe even if the writer interrupts part way through
+        if (index < 0 || index >= count) {
+            RAISE_ARG(ERR_READING_OUT_OF_RANGE, index);
+            return 0;
+        }
+        uint8_t start;
+        uint32_t time;
+        do {
+            start = sequence;
+            time = times[front][index];
+            SNAPSHOT_READ_HOOK();
+        } while ((uint8_t)(sequence - start) >= SNAPSHOT_BUFFERS - 1);
+        return time;
+    }
+
+    void Snapshot::copy(double* destination, int first, int number) {
+        //  Copies some of the readings from one publish, safe even if the writer interrupts part way through
+        if (first < 0 || number < 0 || first + number > count) {
+            RAISE_ARG(ERR_READING_OUT_OF_RANGE, first + number);
+            return;
+        }
+        uint8_t start;
+        do {
+            start = sequence;
+            double* source = buffers[front];
+            for (int i = 0; i < number; i++) {
+                destination[i] = source[first + i];
+                SNAPSHOT_READ_HOOK();
+            }
+        } while ((uint8_t)(sequence - start) >= SNAPSHOT_BUFFERS - 1);
+    }
+
+    uint8_t Snapshot::getSequence() {
+        //  Readers can compare this with the last sequence they saw to tell whether there are new readings
+        return sequence;
+    }
+}
+
+#endif
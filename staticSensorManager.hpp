@@ -0,0 +1,190 @@
+// Static sensor manager is a version of the sensor manager where the sensors
+// and their rates are fixed at compile time, so it needs no heap memory,
+// calls each sensor directly rather than through the vtable, and checks the rates with static_assert
+//
+// Usage:
+//     typedef StaticSensorManager<100,
+//         StaticChannel<VoltageSensor, -1, 10>,
+//         StaticChannel<CurrentSensor, 1, 50>> Manager;
+//     Manager manager(voltage, current);
+
+//  A header guard prevents the file from being included twice
+#ifndef STATIC_SENSOR_MANAGER_H
+#define STATIC_SENSOR_MANAGER_H
+#include "sensor.hpp"
+#include "scheduler.hpp"
+
+namespace Sensor {
+    //  Describes one sensor for the static sensor manager, with its tick and report rates
+    //  in milliseconds, -1 if the sensor should never be called
+    template <class SensorType, int TickRate, int ReportRate>
+    struct StaticChannel {
+        static_assert(TickRate >= 1 || TickRate == -1, "Tick rate must be at least 1 millisecond");
+        static_assert(ReportRate >= 1 || ReportRate == -1, "Read rate must be at least 1 millisecond");
+
+        typedef SensorType Type;
+        static constexpr int tickRate = TickRate;
+        static constexpr int reportRate = ReportRate;
+    };
+
+    //  Holds each sensor and its deadlines, one level of the list per sensor
+    //  The loops over the sensors are recursive calls the compiler unrolls and inlines
+    template <int Index, class... Channels>
+    struct StaticChannels {
+        //  The end of the list, which does nothing
+        void start(uint32_t now) {}
+        void processTicks(uint32_t now, uint32_t& missed) {}
+        void processReports(uint32_t now, uint32_t& missed, double* readings) {}
+        long timeUntilNext(uint32_t now, long minTime) { return minTime; }
+    };
+
+    template <int Index, class First, class... Rest>
+    struct StaticChannels<Index, First, Rest...> {
+        typedef typename First::Type Type;
+
+        Type* sensor;               //  The sensor, with its exact type so it can be called directly
+        uint32_t nextTick;     //  The absolute times of the next tick and report
+        uint32_t nextReport;
+        StaticChannels<Index + 1, Rest...> rest;    //  The rest of the sensors
+
+        StaticChannels(Type& first, typename Rest::Type&... others) : sensor(&first), rest(others...) {}
+
+        void start(uint32_t now) {
+            //  The first tick and report are one period after the sensor manager is created
+            nextTick = now + First::tickRate;
+            nextReport = now + First::reportRate;
+            rest.start(now);
+        }
+
+        void processTicks(uint32_t now, uint32_t& missed) {
+            //  If the next tick time has elapsed, call the tick method
+            if (First::tickRate > 0 && (int32_t)(now - nextTick) >= 0) {
+                uint32_t skipped;
+                nextTick = advanceDeadline(nextTick, First::tickRate, now, skipped);
+                missed += skipped;
+                sensor->Type::tick();   //  Naming the class skips the virtual call
+            }
+            rest.processTicks(now, missed);
+        }
+
+        void processReports(uint32_t now, uint32_t& missed, double* readings) {
+            //  If the next report time has elapsed, call the report method and store the reading
+            if (First::reportRate > 0 && (int32_t)(now - nextReport) >= 0) {
+                uint32_t skipped;
+                nextReport = advanceDeadline(nextReport, First::reportRate, now, skipped);
+                missed += skipped;
+                readings[Index] = sensor->Type::report();
+            }
+            rest.processReports(now, missed, readings);
+        }
+
+        long timeUntilNext(uint32_t now, long minTime) {
+            //  Finds the minimum time to the next tick/report of this or any later sensor
+            if (First::tickRate > 0 && (int32_t)(nextTick - now) < minTime) {
+                minTime = (int32_t)(nextTick - now);
+            }
+            if (First::reportRate > 0 && (int32_t)(nextReport - now) < minTime) {
+                minTime = (int32_t)(nextReport - now);
+            }
+            return rest.timeUntilNext(now, minTime);
+        }
+    };
+
+    template <int CallbackRate, class... Channels>
+    class StaticSensorManager {
+        static_assert(CallbackRate >= 1, "Callback rate must be at least 1 millisecond");
+    public:
+        static constexpr int sensorCount = sizeof...(Channels);  //  The number of sensors in use
+    private:
+        StaticChannels<0, Channels...> channels;    //  The sensors and their deadlines
+        double readings[sensorCount];   //  The last reading from each sensor
+        uint32_t nextCallback;     //  The time for the next callback
+        uint32_t missedDeadlines;  //  The number of deadlines skipped because they were a whole period late
+        ReportCallback reportCallback;  //  The callback function that passes sensor readings back to the program
+
+        void processEvents(uint32_t now);
+    public:
+        StaticSensorManager(typename Channels::Type&... sensors);
+        void setReportCallback(ReportCallback callback);
+        void spin(int maxTime = -1);
+        double getLastReport(int sensorIndex);
+        uint32_t getMissedDeadlines();
+    };
+
+    template <int CallbackRate, class... Channels>
+    StaticSensorManager<CallbackRate, Channels...>::StaticSensorManager(typename Channels::Type&... sensors) : channels(sensors...) {
+        uint32_t now = millis();
+        channels.start(now);
+        nextCallback = now + CallbackRate;
+        missedDeadlines = 0;
+        reportCallback = NULL;
+        for (int i = 0; i < sensorCount; i++) {
+            readings[i] = 0;
+        }
+    }
+
+    template <int CallbackRate, class... Channels>
+    void StaticSensorManager<CallbackRate, Channels...>::setReportCallback(ReportCallback callback) {
+        CHECK(reportCallback == NULL, ERR_CALLBACK_ALREADY_SET)
+        reportCallback = callback;
+    }
+
+    template <int CallbackRate, class... Channels>
+    void StaticSensorManager<CallbackRate, Channels...>::processEvents(uint32_t now) {
+        //  Process any ticks, reports, and callbacks that have happened, in that order
+        channels.processTicks(now, missedDeadlines);
+        channels.processReports(now, missedDeadlines, readings);
+
+        if ((int32_t)(now - nextCallback) >= 0) {
+            uint32_t skipped;
+            nextCallback = advanceDeadline(nextCallback, CallbackRate, now, skipped);
+            missedDeadlines += skipped;
+            if (reportCallback != NULL) {
+                reportCallback(readings);
+            }
+        }
+    }
+
+    template <int CallbackRate, class... Channels>
+    void StaticSensorManager<CallbackRate, Channels...>::spin(int maxTime) {
+        //  The time the spin started, spin time is ignored if -1 is passed in
+        uint32_t start = millis();
+
+        //  Repeats as long as there is spin time remaining or max time is -1
+        while (true) {
+            uint32_t now = millis();
+
+            //  Finds the minimum time to the next tick/report/callback
+            long minTime = channels.timeUntilNext(now, (int32_t)(nextCallback - now));
+
+            if (maxTime >= 0) {
+                long spinTime = maxTime - (int32_t)(now - start);
+                if (spinTime <= 0) break;
+                if (spinTime < minTime) {
+                    minTime = spinTime;
+                }
+            }
+
+            //  If the minimum time is greater than 0
+            if (minTime >= 1) {
+                delay(minTime); //  wait
+                now = millis();
+            }
+
+            processEvents(now);
+        }
+    }
+
+    template <int CallbackRate, class... Channels>
+    double StaticSensorManager<CallbackRate, Channels...>::getLastReport(int sensorIndex) {
+        //  Returns the last reading from the sensor
+        return readings[sensorIndex];
+    }
+
+    template <int CallbackRate, class... Channels>
+    uint32_t StaticSensorManager<CallbackRate, Channels...>::getMissedDeadlines() {
+        return missedDeadlines;
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+// Timing statistics for the sensor manager, recording how long each sensor's tick and report take,
+// how late they run, and how much of the time spin is busy
+// Only compiled in if SENSOR_STATS is defined before the sensor manager is included
+
+//  A header guard prevents the file from being included twice
+#ifndef STATS_H
+#define STATS_H
+
+//  The number of lateness histogram buckets
+//  Bucket 0 counts events on time, bucket i counts events from 2^(i-1) up to 2^i milliseconds late,
+//  and the last bucket counts everything later than that
+#define LATENESS_BUCKETS 6
+
+//  The number of values passed to the callback for each sensor by dumpStats
+#define STATS_FIELDS (9 + LATENESS_BUCKETS)
+
+namespace Sensor {
+    //  The min/max/mean of a set of times, in microseconds
+    struct TimingStats {
+        unsigned long min;
+        unsigned long max;
+        unsigned long total;
+        unsigned long count;
+
+        void reset();
+        void add(unsigned long time);
+        unsigned long mean();
+    };
+
+    //  The timing of one sensor
+    struct SensorStats {
+        TimingStats tick;       //  How long the tick method takes
+        TimingStats report;     //  How long the report method takes
+        unsigned long lateness[LATENESS_BUCKETS];   //  Histogram of how late ticks and reports run, in milliseconds
+        unsigned long maxLateness;  //  The latest a tick or report has run
+        unsigned long missed;   //  The number of tick and report deadlines skipped altogether
+
+        void reset();
+        void addLateness(unsigned long late);
+    };
+
+    void TimingStats::reset() {
+        min = 0xFFFFFFFF;
+        max = 0;
+        total = 0;
+        count = 0;
+    }
+
+    void TimingStats::add(unsigned long time) {
+        if (time < min) min = time;
+        if (time > max) max = time;
+        total += time;
+        count++;
+    }
+
+    unsigned long TimingStats::mean() {
+        if (count == 0) return 0;
+        return total / count;
+    }
+
+    void SensorStats::reset() {
+        tick.reset();
+        report.reset();
+        for (int i = 0; i < LATENESS_BUCKETS; i++) {
+            lateness[i] = 0;
+        }
+        maxLateness = 0;
+        missed = 0;
+    }
+
+    void SensorStats::addLateness(unsigned long late) {
+        //  Finds the bucket by doubling the bucket limit until the lateness fits
+        int bucket = 0;
+        unsigned long limit = 1;
+        while (late >= limit && bucket < LATENESS_BUCKETS - 1) {
+            bucket++;
+            limit *= 2;
+        }
+        lateness[bucket]++;
+        if (late > maxLateness) maxLateness = late;
+    }
+}
+
+#endif
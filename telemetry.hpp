@@ -0,0 +1,105 @@
+// Telemetry packs sensor readings into compact binary frames with a CRC, see telemetryFormat.hpp
+// for the layout, so a serial link carries far more readings than it would as text
+
+//  A header guard prevents the file from being included twice
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include "check.hpp"
+#include "telemetryFormat.hpp"
+
+namespace Sensor {
+    //  Defines a frame callback function type, called with an encoded frame and its length in bytes
+    typedef void (* FrameCallback)(uint8_t*, int);
+
+    class Telemetry {
+    private:
+        uint16_t sequence;  //  The sequence number of the next frame
+        uint8_t decimals[TELEMETRY_MAX_CHANNELS];   //  The decimal places kept for each channel
+
+        int32_t scale(double value, uint8_t places);
+    public:
+        Telemetry();
+        ~Telemetry();
+        void setDecimals(int channel, uint8_t places);
+        uint8_t getDecimals(int channel);
+        int encode(uint8_t* buffer, int size, const double* readings, int count, uint32_t channels, uint32_t timestamp);
+        uint16_t getSequence();
+    };
+
+    Telemetry::Telemetry() {
+        sequence = 0;
+        for (int i = 0; i < TELEMETRY_MAX_CHANNELS; i++) {
+            decimals[i] = TELEMETRY_DEFAULT_DECIMALS;
+        }
+    }
+
+    Telemetry::~Telemetry() {
+        //  Don't need to do anything when the object is destroyed
+    }
+
+    void Telemetry::setDecimals(int channel, uint8_t places) {
+        //  Sets how many decimal places a channel keeps, the host decoder must be told the same
+        //  More places means more precision but a smaller range, 3 places covers +-2 million
+        if (channel < 0 || channel >= TELEMETRY_MAX_CHANNELS) {
+            RAISE_ARG(ERR_TELEMETRY_CHANNEL_OUT_OF_RANGE, channel);
+            return;
+        }
+        if (places > TELEMETRY_MAX_DECIMALS) places = TELEMETRY_MAX_DECIMALS;
+        decimals[channel] = places;
+    }
+
+    uint8_t Telemetry::getDecimals(int channel) {
+        return decimals[channel];
+    }
+
+    int32_t Telemetry::scale(double value, uint8_t places) {
+        //  Scales a reading to a whole number, rounding to the nearest and clamping it into range
+        double scaled = value * telemetryScale(places);
+        if (scaled != scaled) return TELEMETRY_NO_VALUE;    //  Only NaN isn't equal to itself
+        if (scaled >= (double)TELEMETRY_MAX_VALUE) return TELEMETRY_MAX_VALUE;
+        if (scaled <= -(double)TELEMETRY_MAX_VALUE) return -TELEMETRY_MAX_VALUE;
+        return (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+    }
+
+    int Telemetry::encode(uint8_t* buffer, int size, const double* readings, int count, uint32_t channels, uint32_t timestamp) {
+        //  Writes a frame of the readings in the channel bitmap straight into the buffer
+        //  Returns the length of the frame, or 0 if the buffer is too small for it
+        if (count < TELEMETRY_MAX_CHANNELS) {
+            channels &= ((uint32_t)1 << count) - 1;     //  Only the channels that have readings
+        }
+        int length = TELEMETRY_FRAME_SIZE(telemetryChannelCount(channels));
+        if (size < length) {
+            RAISE_ARG(ERR_TELEMETRY_BUFFER_TOO_SMALL, length);
+            return 0;
+        }
+
+        buffer[0] = TELEMETRY_SYNC_1;
+        buffer[1] = TELEMETRY_SYNC_2;
+        telemetryPut16(buffer + 2, sequence);
+        telemetryPut32(buffer + 4, timestamp);
+        telemetryPut32(buffer + 8, channels);
+        uint8_t* out = buffer + TELEMETRY_HEADER_SIZE;
+        for (int i = 0; i < TELEMETRY_MAX_CHANNELS && i < count; i++) {
+            if (channels & ((uint32_t)1 << i)) {
+                telemetryPut32(out, scale(readings[i], decimals[i]));
+                out += 4;
+            }
+        }
+
+        //  The CRC covers everything after the sync bytes
+        uint16_t crc = 0xFFFF;
+        for (uint8_t* byte = buffer + 2; byte < out; byte++) {
+            crc = telemetryCrc(crc, *byte);
+        }
+        telemetryPut16(out, crc);
+
+        sequence++;
+        return length;
+    }
+
+    uint16_t Telemetry::getSequence() {
+        return sequence;
+    }
+}
+
+#endif
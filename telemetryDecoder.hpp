@@ -0,0 +1,182 @@
+// Telemetry decoder turns the binary frames from the sensor manager back into readings on the host
+// It takes a byte at a time, so it can read straight from a serial port,
+// and finds its place again after bytes are lost or corrupted
+// Only uses plain C++, so it builds on the host without the Arduino libraries
+
+//  A header guard prevents the file from being included twice
+#ifndef TELEMETRY_DECODER_H
+#define TELEMETRY_DECODER_H
+#include <string.h>
+#include <math.h>
+#include "telemetryFormat.hpp"
+
+namespace Sensor {
+    //  A decoded frame
+    struct TelemetryFrame {
+        uint16_t sequence;      //  The frame's sequence number
+        uint32_t timestamp;     //  millis() on the board when the frame was encoded
+        uint32_t channels;      //  The channel bitmap, bit i is set if values[i] was in the frame
+        double values[TELEMETRY_MAX_CHANNELS];  //  The values, indexed by channel, NaN if not a number
+    };
+
+    class TelemetryDecoder {
+    private:
+        uint8_t buffer[TELEMETRY_FRAME_SIZE(TELEMETRY_MAX_CHANNELS)];   //  The frame being received
+        int length;     //  The number of bytes of it received so far
+        int expected;   //  The length of the frame, known once the header has arrived
+        uint8_t decimals[TELEMETRY_MAX_CHANNELS];   //  The decimal places kept for each channel
+        TelemetryFrame frame;   //  The last frame decoded
+        bool started;           //  Whether a frame has been decoded yet
+        unsigned long frames;       //  The number of frames decoded
+        unsigned long crcErrors;    //  The number of frames thrown away because the CRC didn't match
+        unsigned long lostFrames;   //  The number of frames missing from the sequence numbers
+
+        bool resync();
+        bool finish();
+    public:
+        TelemetryDecoder();
+        ~TelemetryDecoder();
+        void setDecimals(int channel, uint8_t places);
+        bool push(uint8_t byte);
+        int decode(const uint8_t* data, int size);
+        const TelemetryFrame& getFrame();
+        bool hasValue(int channel);
+        double getValue(int channel);
+        unsigned long getFrames();
+        unsigned long getCrcErrors();
+        unsigned long getLostFrames();
+    };
+
+    TelemetryDecoder::TelemetryDecoder() {
+        length = 0;
+        expected = 0;
+        started = false;
+        frames = 0;
+        crcErrors = 0;
+        lostFrames = 0;
+        memset(&frame, 0, sizeof(frame));
+        for (int i = 0; i < TELEMETRY_MAX_CHANNELS; i++) {
+            decimals[i] = TELEMETRY_DEFAULT_DECIMALS;
+        }
+    }
+
+    TelemetryDecoder::~TelemetryDecoder() {
+        //  Don't need to do anything when the object is destroyed
+    }
+
+    void TelemetryDecoder::setDecimals(int channel, uint8_t places) {
+        //  Must match the decimal places the board's telemetry was given for the channel,
+        //  including the places sensors ask for, e.g. 0 for a clock
+        if (channel < 0 || channel >= TELEMETRY_MAX_CHANNELS) return;
+        if (places > TELEMETRY_MAX_DECIMALS) places = TELEMETRY_MAX_DECIMALS;
+        decimals[channel] = places;
+    }
+
+    bool TelemetryDecoder::push(uint8_t byte) {
+        //  Adds the next byte received, returns true if it finished a frame
+        //  which can then be read with getFrame or getValue
+        if (length == 0 && byte != TELEMETRY_SYNC_1) return false;
+        if (length == 1 && byte != TELEMETRY_SYNC_2) {
+            length = 0;
+            return push(byte);  //  The byte might be the start of the next frame
+        }
+        buffer[length] = byte;
+        length++;
+
+        if (length == TELEMETRY_HEADER_SIZE) {
+            //  The bitmap says how many values follow
+            expected = TELEMETRY_FRAME_SIZE(telemetryChannelCount(telemetryGet32(buffer + 8)));
+        }
+        if (length < TELEMETRY_HEADER_SIZE || length < expected) return false;
+        return finish();
+    }
+
+    bool TelemetryDecoder::finish() {
+        //  Checks the CRC of a whole frame and decodes it
+        int crcStart = expected - TELEMETRY_CRC_SIZE;
+        uint16_t crc = 0xFFFF;
+        for (int i = 2; i < crcStart; i++) {
+            crc = telemetryCrc(crc, buffer[i]);
+        }
+        if (crc != telemetryGet16(buffer + crcStart)) {
+            crcErrors++;
+            return resync();
+        }
+
+        uint16_t sequence = telemetryGet16(buffer + 2);
+        if (started) {
+            lostFrames += (uint16_t)(sequence - frame.sequence - 1);
+        }
+        started = true;
+        frames++;
+
+        frame.sequence = sequence;
+        frame.timestamp = telemetryGet32(buffer + 4);
+        frame.channels = telemetryGet32(buffer + 8);
+        const uint8_t* in = buffer + TELEMETRY_HEADER_SIZE;
+        for (int i = 0; i < TELEMETRY_MAX_CHANNELS; i++) {
+            if (frame.channels & ((uint32_t)1 << i)) {
+                int32_t value = (int32_t)telemetryGet32(in);
+                in += 4;
+                frame.values[i] = value == TELEMETRY_NO_VALUE ? NAN : value / telemetryScale(decimals[i]);
+            }
+        }
+        length = 0;
+        expected = 0;
+        return true;
+    }
+
+    bool TelemetryDecoder::resync() {
+        //  The sync bytes weren't the start of a real frame, so look for one in the bytes after them
+        uint8_t rest[sizeof(buffer)];
+        int count = length - 1;
+        memcpy(rest, buffer + 1, count);
+        length = 0;
+        expected = 0;
+        bool found = false;
+        for (int i = 0; i < count; i++) {
+            if (push(rest[i])) found = true;
+        }
+        return found;
+    }
+
+    int TelemetryDecoder::decode(const uint8_t* data, int size) {
+        //  Pushes a block of bytes, returns the number of frames finished
+        //  Only the last of them can be read back, so push a byte at a time to see every frame
+        int count = 0;
+        for (int i = 0; i < size; i++) {
+            if (push(data[i])) count++;
+        }
+        return count;
+    }
+
+    const TelemetryFrame& TelemetryDecoder::getFrame() {
+        return frame;
+    }
+
+    bool TelemetryDecoder::hasValue(int channel) {
+        //  Whether the last frame had a value for the channel
+        if (channel < 0 || channel >= TELEMETRY_MAX_CHANNELS) return false;
+        return (frame.channels & ((uint32_t)1 << channel)) != 0;
+    }
+
+    double TelemetryDecoder::getValue(int channel) {
+        //  The channel's value in the last frame, NaN if it wasn't in the frame
+        if (!hasValue(channel)) return NAN;
+        return frame.values[channel];
+    }
+
+    unsigned long TelemetryDecoder::getFrames() {
+        return frames;
+    }
+
+    unsigned long TelemetryDecoder::getCrcErrors() {
+        return crcErrors;
+    }
+
+    unsigned long TelemetryDecoder::getLostFrames() {
+        return lostFrames;
+    }
+}
+
+#endif
@@ -0,0 +1,99 @@
+// The layout of the binary telemetry frames, shared by the encoder on the board
+// and the decoder on the host, so it only uses plain C++
+//
+// Frame layout, every field is little endian:
+//     2 bytes  sync, 0xA5 then 0x5A
+//     2 bytes  sequence number, counting up by one each frame so lost frames can be spotted
+//     4 bytes  timestamp, millis() when the frame was encoded
+//     4 bytes  channel bitmap, bit i is set if the frame has a value for channel i
+//     4 bytes  for each channel in the bitmap, lowest channel first, the value as a
+//              signed integer scaled by 10^decimals for that channel
+//     2 bytes  CRC16-CCITT of everything after the sync bytes
+
+//  A header guard prevents the file from being included twice
+#ifndef TELEMETRY_FORMAT_H
+#define TELEMETRY_FORMAT_H
+#include <stdint.h>
+
+//  The bytes every frame starts with
+#define TELEMETRY_SYNC_1 0xA5
+#define TELEMETRY_SYNC_2 0x5A
+
+//  The size of the fields before and after the values, in bytes
+#define TELEMETRY_HEADER_SIZE 12
+#define TELEMETRY_CRC_SIZE 2
+
+//  The max number of channels in a frame, one for each bit of the bitmap
+#define TELEMETRY_MAX_CHANNELS 32
+
+//  The size of a frame with a number of channels in it, in bytes
+#define TELEMETRY_FRAME_SIZE(channels) (TELEMETRY_HEADER_SIZE + 4 * (channels) + TELEMETRY_CRC_SIZE)
+
+//  The number of decimal places each value keeps unless told otherwise, and the most it can keep
+#define TELEMETRY_DEFAULT_DECIMALS 3
+#define TELEMETRY_MAX_DECIMALS 9
+
+//  The values sent for readings that aren't numbers and readings too big to fit
+#define TELEMETRY_NO_VALUE ((int32_t)0x80000000)
+#define TELEMETRY_MAX_VALUE ((int32_t)0x7FFFFFFF)
+
+namespace Sensor {
+    uint16_t telemetryCrc(uint16_t crc, uint8_t byte);
+    int telemetryChannelCount(uint32_t channels);
+    double telemetryScale(uint8_t decimals);
+    void telemetryPut16(uint8_t* out, uint16_t value);
+    void telemetryPut32(uint8_t* out, uint32_t value);
+    uint16_t telemetryGet16(const uint8_t* in);
+    uint32_t telemetryGet32(const uint8_t* in);
+
+    uint16_t telemetryCrc(uint16_t crc, uint8_t byte) {
+        //  Adds a byte to a CRC16-CCITT (polynomial 0x1021), which starts at 0xFFFF
+        //  Worked out a bit at a time rather than with a table, to save memory on the board
+        crc ^= (uint16_t)byte << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        return crc;
+    }
+
+    int telemetryChannelCount(uint32_t channels) {
+        //  The number of values in a frame with this bitmap
+        int count = 0;
+        while (channels != 0) {
+            channels &= channels - 1;   //  Clears the lowest set bit
+            count++;
+        }
+        return count;
+    }
+
+    double telemetryScale(uint8_t decimals) {
+        //  The number a value is multiplied by to keep the decimal places
+        double scale = 1;
+        for (int i = 0; i < decimals; i++) {
+            scale *= 10;
+        }
+        return scale;
+    }
+
+    void telemetryPut16(uint8_t* out, uint16_t value) {
+        out[0] = value;
+        out[1] = value >> 8;
+    }
+
+    void telemetryPut32(uint8_t* out, uint32_t value) {
+        out[0] = value;
+        out[1] = value >> 8;
+        out[2] = value >> 16;
+        out[3] = value >> 24;
+    }
+
+    uint16_t telemetryGet16(const uint8_t* in) {
+        return (uint16_t)in[0] | (uint16_t)in[1] << 8;
+    }
+
+    uint32_t telemetryGet32(const uint8_t* in) {
+        return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+    }
+}
+
+#endif
@@ -4,6 +4,8 @@
 #ifndef TEMPERATURE_H
 #define TEMPERATURE_H
 #include "sensor.hpp"//  Include the parent sensor
+#include "adcStream.hpp"//  Reads pause the ADC stream if it is running
+#include "fixed.hpp"//  Readings are converted with fixed point maths
 
 //  Values from calibration
 #define MINTEMP 15.0
@@ -13,19 +15,37 @@
 #define TEMP_GRADIENT ((MAXMV - MINMV) / (MAXTEMP - MINTEMP))
 
 namespace Sensor {
+    //  The calibration line folded into degrees per ADC code and degrees at code 0, at compile time
+    //  5000/1023 -- is the ratio of millivolts to bits
+    constexpr Fixed TEMP_PER_CODE = Fixed((5000.0 / 1023.0) / TEMP_GRADIENT);
+    constexpr Fixed TEMP_AT_ZERO = Fixed(MINTEMP - MINMV / TEMP_GRADIENT);
+
+    //  The same calibration as a curve for a lookup table, in order of ADC code
+    //  The thermistor isn't really linear, so measured points in between can be added here
+    //  and the table given to the sensor with setCalibration
+    struct TemperatureCurve : CalibrationCurve {
+        static constexpr int count = 2;
+        static constexpr CalibrationPoint points[count] = {
+            {MAXMV * 1023.0 / 5000.0, MAXTEMP},
+            {MINMV * 1023.0 / 5000.0, MINTEMP}
+        };
+    };
+    constexpr CalibrationPoint TemperatureCurve::points[];
+
     class TemperatureSensor : public Sensor {
     private:
-        uint8_t vin;    //  Voltage input pin
+        AnalogInput vin;    //  Voltage input pin
     public:
         TemperatureSensor(uint8_t pin);   //  Called when a new sensor object is created
         ~TemperatureSensor();  //  Called when a sensor object is destroyed
         void tick();        //  Both called by the sensor manager
         double report();
+        void attach(Acquisition& acquisition);
+        Fixed reportFixed();    //  The reading in degrees, without any floating point maths
     };
 
-    TemperatureSensor::TemperatureSensor(uint8_t pin) {
+    TemperatureSensor::TemperatureSensor(uint8_t pin) : vin(pin) {
         //  Setup and store the input pin 
-        vin = pin;
         pinMode(pin, INPUT);
     }
 
@@ -34,16 +54,30 @@ namespace Sensor {
     }
 
     void TemperatureSensor::tick() {
-        //  No averaging applied
+        //  Samples are only taken on ticks when there is a filter to average them
+        if (filter != NULL) {
+            filter->push(vin.read());
+        }
+    }
+
+    void TemperatureSensor::attach(Acquisition& acquisition) {
+        //  Read the input pin in the sensor manager's acquisition pass
+        vin.attach(acquisition);
     }
 
     double TemperatureSensor::report() {
-        // Takes an analog voltage reading, applies a calibration and returns the temperature
         //  Called by the sensor manager when a reading should be reported
-        int reading = analogRead(vin); //  Read from the voltage input and convert it to a voltage (in millivolts)
-        double voltage = (5000.0 / 1023.0) * (double)reading;
-        double temperature = (voltage - MINMV) / TEMP_GRADIENT + MINTEMP;//  Calculate the temperature from the calibration values
-        return temperature;
+        return reportFixed().toDouble();
+    }
+
+    Fixed TemperatureSensor::reportFixed() {
+        // Takes an analog voltage reading, applies a calibration and returns the temperature
+        //  The filtered reading if there is one, otherwise read from the voltage input
+        Fixed reading = filter != NULL && filter->ready() ? filter->output() : Fixed(vin.read());
+        if (calibration != NULL) {
+            return calibration->convert(reading);   //  Look the temperature up in the calibration table
+        }
+        return TEMP_PER_CODE * reading + TEMP_AT_ZERO;//  Calculate the temperature from the calibration values
     }
 }
 
@@ -0,0 +1,83 @@
+// Tests calibration tables against values worked out by hand from their curves,
+// at the points, between them, past the ends of the curve and past the ends of the table
+
+#include "calibration.hpp"
+#include "test.hpp"
+
+using namespace Sensor;
+
+//  The curve from the usage in calibration.hpp
+struct ThermistorCurve : CalibrationCurve {
+    static constexpr int count = 3;
+    static constexpr CalibrationPoint points[count] = {{150, 120.0}, {480, 45.0}, {890, 5.0}};
+};
+constexpr CalibrationPoint ThermistorCurve::points[];
+
+//  A differential curve whose ends don't fit in an entry
+struct WideCurve : CalibrationCurve {
+    static constexpr int firstCode = -512;
+    static constexpr int count = 2;
+    static constexpr CalibrationPoint points[count] = {{-512, -1000.0}, {512, 1000.0}};
+};
+constexpr CalibrationPoint WideCurve::points[];
+
+typedef CalibrationData<ThermistorCurve, CalibrationRange<CALIBRATION_TABLE_DOUBLINGS>::type> ThermistorData;
+
+//  The entries are worked out at compile time, in 1/64ths
+static_assert(calibrationSegment<ThermistorCurve>(100, 0) == 0, "Codes before the curve are on the first segment");
+static_assert(calibrationSegment<ThermistorCurve>(480, 0) == 1, "A point starts the next segment");
+static_assert(calibrationSegment<ThermistorCurve>(1000, 0) == 1, "Codes after the curve are on the last segment");
+static_assert(calibrationEntry<ThermistorCurve>(150) == 120 * 64, "The first point");
+static_assert(calibrationEntry<ThermistorCurve>(315) == 5280, "82.5 halfway along the first segment");
+static_assert(calibrationEntry<ThermistorCurve>(890) == 5 * 64, "The last point");
+static_assert(calibrationEntry<WideCurve>(0) == -32768, "Entries too small are clamped");
+static_assert(calibrationEntry<WideCurve>(1023) == 32767, "Entries too big are clamped");
+
+void testTable() {
+    //  The table has an entry for every code, and the entries are the ones worked out above
+    EXPECT(sizeof(ThermistorData::table) / sizeof(ThermistorData::table[0]) == CALIBRATION_TABLE_SIZE);
+    EXPECT(ThermistorData::table[150] == 7680);
+    EXPECT(ThermistorData::table[480] == 2880);
+    EXPECT(ThermistorData::table[685] == 1600);
+}
+
+void testPoints() {
+    //  The calibration points and the middles of segments come back exactly
+    CalibrationTable<ThermistorCurve> thermistor;
+    EXPECT(thermistor.convert(150).toDouble() == 120);
+    EXPECT(thermistor.convert(480).toDouble() == 45);
+    EXPECT(thermistor.convert(890).toDouble() == 5);
+    EXPECT(thermistor.convert(315).toDouble() == 82.5);
+    EXPECT(thermistor.convert(685).toDouble() == 25);
+
+    //  A fractional code moves between the entries either side, 5280 and 5265 (82.2727 rounded)
+    EXPECT(thermistor.convert(Fixed(315.5)).toDouble() == 82.3828125);
+}
+
+void testEnds() {
+    //  Codes off the curve follow its end segments, 154.09 at 0 and -7.98 at 1023, to the nearest 1/64
+    CalibrationTable<ThermistorCurve> thermistor;
+    EXPECT(thermistor.convert(0).toDouble() == 9862 / 64.0);
+    EXPECT(thermistor.convert(1023).toDouble() == -510 / 64.0);
+
+    //  Codes off the table are clamped to its ends
+    EXPECT(thermistor.convert(-5).toDouble() == 9862 / 64.0);
+    EXPECT(thermistor.convert(Fixed(-0.5)).toDouble() == 9862 / 64.0);
+    EXPECT(thermistor.convert(2000).toDouble() == -510 / 64.0);
+    EXPECT(thermistor.convert(Fixed(1023.5)).toDouble() == -510 / 64.0);
+
+    //  A table starting at a negative code
+    CalibrationTable<WideCurve> wide;
+    EXPECT(wide.convert(0).toDouble() == 0);
+    EXPECT(wide.convert(256).toDouble() == 500);
+    EXPECT(wide.convert(-256).toDouble() == -500);
+    EXPECT(wide.convert(-600).toDouble() == -512);
+    EXPECT(wide.convert(600).toDouble() == 32767 / 64.0);
+}
+
+int main() {
+    testTable();
+    testPoints();
+    testEnds();
+    return testResult();
+}
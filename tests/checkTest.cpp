@@ -0,0 +1,38 @@
+// Tests that errors are logged with the short name of the file they were raised in
+
+#include "sensor.hpp"
+#include "test.hpp"
+
+int main() {
+    static_assert(errorFileId(errorBaseName("/home/user/Arduino/libraries/Sensors/clock.hpp", "")) == ERR_FILE_CLOCK,
+                  "Files are found from their absolute path");
+    static_assert(errorFileId(errorBaseName("C:\\Sensors\\sensor.hpp", "")) == ERR_FILE_SENSOR,
+                  "Files are found from Windows paths");
+    static_assert(errorFileId("sensor.hp") == ERR_FILE_OTHER, "Only whole names match");
+
+    ErrorRecord record;
+    char message[96];
+    errorLog.setHalting(false);
+
+    //  An error raised in a library file keeps its name
+    class Rated : public Sensor::Sensor {
+    public:
+        void tick() {}
+        double report() { return 0; }
+    } sensor;
+    sensor.setTickRate(0);
+    EXPECT(errorLog.pop(record));
+    EXPECT(record.code == ERR_TICK_RATE_TOO_LOW && record.file == ERR_FILE_SENSOR);
+    errorLog.format(record, message, sizeof(message));
+    EXPECT(strncmp(message, "Error at sensor.hpp line ", 25) == 0);
+
+    //  And one raised anywhere else is from the sketch
+    RAISE_ARG(ERR_SENSOR_NOT_FOUND, 7);
+    EXPECT(errorLog.pop(record));
+    EXPECT(record.file == ERR_FILE_OTHER && record.arg == 7);
+    errorLog.format(record, message, sizeof(message));
+    EXPECT(strstr(message, "Error at sketch line ") == message);
+    EXPECT(strstr(message, "Sensor not found. (7)") != NULL);
+    EXPECT(!errorLog.pop(record));
+    return testResult();
+}
@@ -0,0 +1,112 @@
+// Tests each filter stage against outputs worked out by hand, and that a pipeline
+// scales its output by the fraction bits its stages add
+
+#include "filter.hpp"
+#include "test.hpp"
+
+using namespace Sensor;
+
+void testMedian() {
+    //  A single sample spike is thrown away, one lasting half the window gets through
+    MedianStage<3> median;
+    const int32_t samples[] = {10, 10, 100, 10, 10, 100, 100, 10};
+    const int32_t expected[] = {10, 10, 10, 10, 10, 10, 100, 100};
+    int32_t output;
+    for (int i = 0; i < 8; i++) {
+        EXPECT(median.push(samples[i], output));
+        EXPECT(output == expected[i]);
+    }
+}
+
+void testOversample() {
+    //  Only every 4th sample gives an output, the average with 1 extra bit
+    OversampleStage<4, 1> oversample;
+    int32_t output = -1;
+    int outputs = 0;
+    for (int i = 1; i <= 12; i++) {
+        if (oversample.push(i, output)) {
+            outputs++;
+            EXPECT(i % 4 == 0);
+            EXPECT(output == (4 * i - 6) * 2 / 4);    //  The sum of i - 3 to i, doubled and divided by 4
+        }
+    }
+    EXPECT(outputs == 3);
+    EXPECT(output == 21);   //  10.5 in halves
+}
+
+void testEma() {
+    //  Starts at the first sample, then moves a quarter of the way to a step each sample, rounded
+    EmaStage<2> ema;
+    int32_t output;
+    EXPECT(ema.push(0, output) && output == 0);
+    const int32_t expected[] = {25, 44, 58, 69};
+    for (int i = 0; i < 4; i++) {
+        EXPECT(ema.push(100, output));
+        EXPECT(output == expected[i]);
+    }
+    for (int i = 0; i < 40; i++) {
+        ema.push(100, output);
+    }
+    EXPECT(output == 100);
+}
+
+void testCic() {
+    //  A gain of 4^2 = 16, 4 bits, of which 2 are kept as the fraction
+    typedef CicStage<4, 2, 2> Cic;
+    static_assert(Cic::growthBits == 4, "The gain is Order * log2(Decimation) bits");
+    static_assert(Cic::fractionBits == 2, "The kept bits are the fraction");
+    Cic cic;
+    int32_t output = 0;
+    int outputs = 0;
+    for (int i = 0; i < 16; i++) {
+        if (cic.push(100, output)) outputs++;
+    }
+    //  Once settled a steady input comes out as itself in quarters
+    EXPECT(outputs == 4);
+    EXPECT(output == 400);
+
+    //  A negative input comes out negative even though the integrators wrap
+    cic.reset();
+    for (int i = 0; i < 16; i++) {
+        cic.push(-3, output);
+    }
+    EXPECT(output == -12);
+}
+
+void testPipelineOutput() {
+    //  The fraction bits of every stage add up, and output() turns them into the fraction of a sample
+    FilterPipeline<OversampleStage<4, 2>> oversample;
+    EXPECT(oversample.getFractionBits() == 2);
+    EXPECT(!oversample.push(1) && !oversample.push(2) && !oversample.push(2));
+    EXPECT(!oversample.ready());
+    EXPECT(oversample.push(2));
+    EXPECT(oversample.ready());
+    EXPECT(oversample.value() == 7);
+    EXPECT(oversample.output().raw() == 7 << 14);
+    EXPECT(oversample.output().toDouble() == 1.75);
+
+    FilterPipeline<MedianStage<3>, OversampleStage<4, 2>, CicStage<2, 1, 1>> stacked;
+    EXPECT(stacked.getFractionBits() == 3);
+    for (int i = 0; i < 32; i++) {
+        stacked.push(511);
+    }
+    EXPECT(stacked.value() == 511 * 8);
+    EXPECT(stacked.output().toDouble() == 511);
+
+    //  With no extra bits the output is the sample
+    FilterPipeline<MedianStage<3>> median;
+    median.push(-20);
+    EXPECT(median.output().toDouble() == -20);
+
+    stacked.reset();
+    EXPECT(!stacked.ready() && stacked.value() == 0);
+}
+
+int main() {
+    testMedian();
+    testOversample();
+    testEma();
+    testCic();
+    testPipelineOutput();
+    return testResult();
+}
@@ -0,0 +1,63 @@
+// Tests the host HAL's virtual clock, that it only moves when waited on and wraps like the board's
+
+#include "halHost.hpp"
+#include "test.hpp"
+
+//  The virtual time millis() wraps at, in microseconds
+const uint64_t MILLIS_WRAP = 4294967296000ULL;
+
+int rampSource(uint8_t channel, unsigned long time) {
+    return (time / 1000) % 1024;
+}
+
+void testDelays() {
+    hostHal.reset();
+    EXPECT(millis() == 0);
+    EXPECT(micros() == 0);
+    delay(10);
+    EXPECT(millis() == 10);
+    delayMicroseconds(500);
+    EXPECT(micros() == 10500);
+
+    //  Each analogRead takes a conversion, and reads the source at the start of it
+    hostHal.setAnalogSource(A0, rampSource);
+    EXPECT(analogRead(A0) == 10);
+    EXPECT(micros() == 10500 + HOST_ANALOG_READ_TIME);
+    EXPECT(hostHal.getAnalogReads() == 1);
+}
+
+void testWrap() {
+    hostHal.reset();
+    hostHal.setTime(MILLIS_WRAP - 5000);
+    EXPECT(millis() == 4294967291UL);
+    uint32_t start = millis();
+    delay(10);
+    //  millis() has wrapped, but the time since start is still right
+    EXPECT(millis() == 5);
+    EXPECT(millis() - start == 10);
+    EXPECT((int32_t)(start - millis()) < 0);
+
+    //  micros() wraps every 2^32 microseconds
+    hostHal.setTime(4294967296ULL - 100);
+    uint32_t before = micros();
+    delayMicroseconds(200);
+    EXPECT(micros() == 100);
+    EXPECT(micros() - before == 200);
+}
+
+void testRtc() {
+    //  Moving the time doesn't move the RTC with it
+    hostHal.reset();
+    hostHal.setRtc(1704067200);
+    hostHal.setTime(MILLIS_WRAP - 5000000);
+    EXPECT(hostHal.readRtc() == 1704067200);
+    delay(2000);
+    EXPECT(hostHal.readRtc() == 1704067202);
+}
+
+int main() {
+    testDelays();
+    testWrap();
+    testRtc();
+    return testResult();
+}
@@ -0,0 +1,96 @@
+// Tests that the logger only writes out of turn when the next frame wouldn't fit,
+// and that a block is written once even when the sync after it fails
+
+#include "logger.hpp"
+#include "halHost.hpp"
+#include "test.hpp"
+
+using namespace Sensor;
+
+//  Storage that counts what it is given and can be told to fail
+class FakeStorage : public LogStorage {
+public:
+    int writes = 0;
+    int syncs = 0;
+    bool failWrites = false;
+    bool failSyncs = false;
+    uint8_t last[LOGGER_BLOCK_SIZE];
+    bool write(const uint8_t* block, int size) {
+        if (failWrites) return false;
+        memcpy(last, block, size);
+        writes++;
+        return true;
+    }
+    bool sync() {
+        if (failSyncs) return false;
+        syncs++;
+        return true;
+    }
+};
+
+void testNearlyFull() {
+    //  A full block can wait while there is room for another frame as long as the longest so far
+    FakeStorage storage;
+    Logger logger(&storage);
+    uint8_t frame[100];
+    memset(frame, 0xAA, sizeof(frame));
+    for (int i = 0; i < 6; i++) {
+        EXPECT(logger.log(frame, sizeof(frame)));
+    }
+    EXPECT(logger.hasFullBlock());
+    EXPECT(!logger.isNearlyFull());
+
+    //  1500 bytes in the ring leaves 36, so the next frame would be dropped
+    for (int i = 0; i < 9; i++) {
+        EXPECT(logger.log(frame, sizeof(frame)));
+    }
+    EXPECT(logger.getFree() == LOGGER_BLOCKS * LOGGER_BLOCK_SIZE - 1500);
+    EXPECT(logger.isNearlyFull());
+    EXPECT(logger.writeBlock());
+    EXPECT(!logger.isNearlyFull());
+    EXPECT(logger.getFramesDropped() == 0);
+}
+
+void testSyncFailure() {
+    //  A block that was written isn't written again because the sync after it failed
+    FakeStorage storage;
+    Logger logger(&storage);
+    uint8_t block[LOGGER_BLOCK_SIZE];
+    storage.failSyncs = true;
+    for (int i = 0; i < LOGGER_SYNC_BLOCKS; i++) {
+        memset(block, i, sizeof(block));
+        EXPECT(logger.log(block, sizeof(block)));
+        EXPECT(logger.writeBlock());
+        EXPECT(storage.last[0] == i);
+    }
+    EXPECT(storage.writes == LOGGER_SYNC_BLOCKS);
+    EXPECT(logger.getBlocksWritten() == LOGGER_SYNC_BLOCKS);
+    EXPECT(logger.getSyncErrors() == 1);
+    EXPECT(logger.getWriteErrors() == 0);
+    EXPECT(!logger.hasFullBlock());
+
+    //  The sync is tried again after the next block
+    storage.failSyncs = false;
+    EXPECT(logger.log(block, sizeof(block)));
+    EXPECT(logger.writeBlock());
+    EXPECT(storage.syncs == 1);
+    EXPECT(logger.getSyncErrors() == 1);
+
+    //  A failed write keeps the block for next time
+    storage.failWrites = true;
+    EXPECT(logger.log(block, sizeof(block)));
+    EXPECT(!logger.writeBlock());
+    EXPECT(logger.getWriteErrors() == 1);
+    EXPECT(logger.hasFullBlock());
+    storage.failWrites = false;
+    EXPECT(logger.writeBlock());
+    EXPECT(storage.writes == LOGGER_SYNC_BLOCKS + 2);
+    EXPECT(!logger.hasFullBlock());
+}
+
+int main() {
+    hostHal.reset();
+    testNearlyFull();
+    testSyncFailure();
+    return testResult();
+}
@@ -0,0 +1,94 @@
+// Tests that a push button read through the acquisition only produces events when it is pressed
+
+#include "sensorManager.hpp"
+#include "test.hpp"
+
+using namespace Sensor;
+
+#define BUTTON_PIN 2
+
+//  A sensor that always reports the same reading
+class SteadySensor : public Sensor::Sensor {
+public:
+    void tick() {}
+    double report() { return 5; }
+};
+
+bool faultSeen = false;
+
+void checkReadings(double* readings) {
+    //  Diagnostic mode injects 999 into the sensors from the third on
+    if (readings[2] == 999) faultSeen = true;
+}
+
+void testIdle() {
+    //  Polling the snapshot before the first scan mustn't see the button as pressed
+    hostHal.reset();
+    hostHal.setDigital(BUTTON_PIN, HIGH);
+    Acquisition acquisition;
+    PushButton button(BUTTON_PIN);
+    button.setup();
+    button.attach(acquisition);
+    ButtonEvent event;
+    bool any = false;
+    for (int i = 0; i < 300; i++) {
+        delay(10);
+        if (button.getEvent(event)) any = true;
+    }
+    EXPECT(!any);
+    EXPECT(!button.isPressed());
+}
+
+void testLongPress() {
+    //  A real press held past the long press time gives both events, once each
+    hostHal.reset();
+    hostHal.setDigital(BUTTON_PIN, HIGH);
+    Acquisition acquisition;
+    PushButton button(BUTTON_PIN);
+    button.setup();
+    button.attach(acquisition);
+    hostHal.setDigital(BUTTON_PIN, LOW);
+    int pressed = 0;
+    int longPressed = 0;
+    ButtonEvent event;
+    for (int i = 0; i < 150; i++) {
+        acquisition.scan();
+        while (button.getEvent(event)) {
+            if (event.kind == BUTTON_PRESSED) pressed++;
+            if (event.kind == BUTTON_LONG_PRESSED) longPressed++;
+        }
+        delay(10);
+    }
+    EXPECT(pressed == 1);
+    EXPECT(longPressed == 1);
+}
+
+void testDiagButton() {
+    //  An idle diagnostic button reporting slowly doesn't turn diagnostic mode on
+    hostHal.reset();
+    hostHal.setDigital(BUTTON_PIN, HIGH);
+    PushButton button(BUTTON_PIN);
+    button.setReportRate(2000);
+    button.setup();
+    SteadySensor first;
+    SteadySensor second;
+    first.setReportRate(100);
+    second.setReportRate(100);
+
+    SensorManager manager(3, 100);
+    manager.setReportCallback(checkReadings);
+    manager.setDiagButton(&button);
+    manager.addSensor(&first);
+    manager.addSensor(&button);
+    manager.addSensor(&second);
+    manager.spin(3000);
+    EXPECT(!button.isPressed());
+    EXPECT(!faultSeen);
+}
+
+int main() {
+    testIdle();
+    testLongPress();
+    testDiagButton();
+    return testResult();
+}
@@ -0,0 +1,103 @@
+// Tests that a session recorded with record.hpp replays in order through the same sensors
+// to exactly the readings it gave when it was recorded
+
+#define SENSOR_RECORD
+#include "sensorManager.hpp"
+#include "voltage.hpp"
+#include "pushButton.hpp"
+#include "replay.hpp"
+#include "test.hpp"
+#include <vector>
+
+using namespace Sensor;
+
+#define VOLTAGE_PIN A0
+#define BUTTON_PIN 7
+#define RECORD_TIME 2000
+#define READINGS (RECORD_TIME / 10)
+
+//  Keeps the blocks the logger writes in memory, for the replay to parse
+class MemoryStorage : public LogStorage {
+public:
+    std::vector<uint8_t> data;
+    bool write(const uint8_t* block, int size) {
+        data.insert(data.end(), block, block + size);
+        return true;
+    }
+    bool sync() { return true; }
+};
+
+//  A noisy input, so a value read out of order would show in the readings
+int noise(uint8_t channel, unsigned long time) {
+    return 500 + (int)((time * 2654435761u) >> 23) % 37;
+}
+
+//  A button pressed and let go every 700ms
+int presses(uint8_t pin, unsigned long time) {
+    return (time / 700000) % 2;
+}
+
+double readings[2][READINGS][2];
+int reports = 0;
+int run = 0;
+
+void keepReadings(double* values) {
+    if (reports < READINGS) {
+        readings[run][reports][0] = values[0];
+        readings[run][reports][1] = values[1];
+    }
+    reports++;
+}
+
+void spin(Logger* captureLogger) {
+    //  The same sensors and rates for the recording and the replay
+    reports = 0;
+    SensorManager manager(4, 10);
+    VoltageSensor voltage(VOLTAGE_PIN, 1.0);
+    voltage.setTickRate(5);
+    voltage.setReportRate(10);
+    FilterPipeline<MedianStage<3>, EmaStage<2>> filter;
+    voltage.attachFilter(&filter);
+    PushButton button(BUTTON_PIN);
+    button.setTickRate(10);
+    button.setReportRate(10);
+    manager.addSensor(&voltage);
+    manager.addSensor(&button);
+    manager.setReportCallback(keepReadings);
+    if (captureLogger != NULL) manager.setCaptureLogger(captureLogger);
+    manager.spin(RECORD_TIME);
+}
+
+int main() {
+    hostHal.reset();
+    hostHal.setAnalogSource(VOLTAGE_PIN, noise);
+    hostHal.setDigitalSource(presses);
+    MemoryStorage storage;
+    Logger captureLogger(&storage, 4);
+    recorder.begin(&captureLogger);
+    spin(&captureLogger);
+    recorder.end();
+    EXPECT(captureLogger.flush());
+    EXPECT(reports == READINGS);
+    EXPECT(recorder.getRecords() > 0);
+    EXPECT(recorder.getDropped() == 0);
+
+    hostHal.reset();
+    replay.parse(storage.data.data(), storage.data.size());
+    EXPECT(replay.getRecords() == recorder.getRecords());
+    EXPECT(replay.getBadRecords() == 0);
+    replay.begin(REPLAY_IN_ORDER);
+    run = 1;
+    spin(NULL);
+    EXPECT(reports == READINGS);
+    EXPECT(replay.getUnderruns() == 0);
+    EXPECT(replay.isFinished());
+    replay.end();
+
+    int same = 0;
+    for (int i = 0; i < READINGS; i++) {
+        if (readings[0][i][0] == readings[1][i][0] && readings[0][i][1] == readings[1][i][1]) same++;
+    }
+    EXPECT(same == READINGS);
+    return testResult();
+}
@@ -0,0 +1,104 @@
+// Tests that the scheduler and both sensor managers keep to their deadlines when millis() wraps,
+// which happens on the board after 49.7 days
+
+#define SENSOR_STATS
+#include "sensorManager.hpp"
+#include "staticSensorManager.hpp"
+#include "clock.hpp"
+#include "test.hpp"
+
+using namespace Sensor;
+
+//  The virtual time millis() wraps at, in microseconds
+const uint64_t MILLIS_WRAP = 4294967296000ULL;
+
+//  A sensor that counts its ticks and reports them
+class CountingSensor : public Sensor::Sensor {
+public:
+    unsigned int ticks = 0;
+    unsigned int reports = 0;
+    void tick() { ticks++; }
+    double report() { reports++; return ticks; }
+};
+
+int callbacks = 0;
+
+void countCallback(double* readings) {
+    callbacks++;
+}
+
+void testOrdering() {
+    //  A deadline just after the wrap is later than one just before it, even though it is a smaller number
+    Scheduler scheduler(4);
+    int after = scheduler.add(REPORT_EVENT, 0, 100, 0x00000010);
+    int before = scheduler.add(TICK_EVENT, 1, 100, 0xFFFFFFF0);
+    EXPECT(scheduler.next() == before);
+    EXPECT(scheduler.timeUntilNext(0xFFFFFFE0) == 16);
+    EXPECT(scheduler.timeUntilNext(0x00000000) == -16);
+
+    //  Once the first is moved on past the second, the second is next
+    EXPECT(scheduler.advance(before, 0xFFFFFFF0) == 0);
+    EXPECT(scheduler.getEvent(before).deadline == 0x00000054);
+    EXPECT(scheduler.next() == after);
+
+    //  Deadlines missed by whole periods across the wrap are skipped
+    uint32_t skipped;
+    uint32_t next = advanceDeadline(0xFFFFFF00, 100, 0x00000100, skipped);
+    EXPECT(skipped == 4);
+    EXPECT(next == 0x000000F4);
+    EXPECT(scheduler.getMissedDeadlines() == 0);
+}
+
+void testSensorManager() {
+    //  Starts 2 seconds before the wrap and runs 5 seconds, every deadline should be kept
+    hostHal.reset();
+    hostHal.setTime(MILLIS_WRAP - 2000000);
+    callbacks = 0;
+
+    //  The clock is set up first, waiting for the RTC's second would make the sensors late
+    Clock clock;
+    clock.setReportRate(1000);
+    clock.setup();
+
+    SensorManager manager(2, 100);
+    manager.setReportCallback(countCallback);
+    CountingSensor sensor;
+    sensor.setTickRate(10);
+    sensor.setReportRate(100);
+    manager.addSensor(&sensor);
+    manager.addSensor(&clock);
+
+    double startTime = clock.report();
+    manager.spin(5000);
+    EXPECT(sensor.ticks >= 499 && sensor.ticks <= 501);
+    EXPECT(sensor.reports >= 49 && sensor.reports <= 51);
+    EXPECT(callbacks >= 49 && callbacks <= 51);
+    EXPECT(manager.getStats(0).missed == 0);
+    EXPECT(manager.getStats(0).maxLateness <= 2);
+
+    //  The clock keeps counting through the wrap
+    double elapsed = clock.report() - startTime;
+    EXPECT(elapsed > 4.9 && elapsed < 5.1);
+}
+
+void testStaticSensorManager() {
+    hostHal.reset();
+    hostHal.setTime(MILLIS_WRAP - 2000000);
+    callbacks = 0;
+
+    CountingSensor sensor;
+    StaticSensorManager<100, StaticChannel<CountingSensor, 10, 100>> manager(sensor);
+    manager.setReportCallback(countCallback);
+    manager.spin(5000);
+    EXPECT(sensor.ticks >= 499 && sensor.ticks <= 501);
+    EXPECT(sensor.reports >= 49 && sensor.reports <= 51);
+    EXPECT(callbacks >= 49 && callbacks <= 51);
+    EXPECT(manager.getMissedDeadlines() == 0);
+}
+
+int main() {
+    testOrdering();
+    testSensorManager();
+    testStaticSensorManager();
+    return testResult();
+}
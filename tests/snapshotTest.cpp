@@ -0,0 +1,96 @@
+// Tests that readings are only seen once published, that the sequence counts publishes,
+// and that a read the writer reuses the buffer under is read again
+
+//  Lets the test publish part way through a read, as an interrupt would
+void interruptRead();
+#define SNAPSHOT_READ_HOOK() interruptRead()
+
+#include "snapshot.hpp"
+#include "test.hpp"
+
+using namespace Sensor;
+
+Snapshot* interrupted = NULL;  //  The snapshot the interrupt writes to
+int interruptAt = -1;   //  The read step the interrupt comes at, -1 for never
+int publishes = 0;      //  How many times it publishes
+int steps = 0;          //  The read steps so far
+
+void interruptRead() {
+    if (steps++ != interruptAt) return;
+    //  Each publish writes the next value into every reading, the last one is left in the back buffer
+    for (int i = 0; i <= publishes; i++) {
+        double value = 10 * (i + 1);
+        interrupted->set(0, value, 0);
+        interrupted->set(1, value, 0);
+        if (i < publishes) interrupted->publish();
+    }
+}
+
+void testPublish() {
+    //  Readings written to the back buffer appear all at once when published
+    Snapshot snapshot(3);
+    EXPECT(snapshot.getSequence() == 0);
+    EXPECT(!snapshot.publish());
+    EXPECT(snapshot.getSequence() == 0);
+
+    snapshot.set(0, 1.5, 100);
+    snapshot.set(2, -3, 200);
+    EXPECT(snapshot.get(0) == 0);
+    EXPECT(snapshot.publish());
+    EXPECT(snapshot.getSequence() == 1);
+    EXPECT(snapshot.read()[0] == 1.5 && snapshot.read()[1] == 0 && snapshot.read()[2] == -3);
+    EXPECT(snapshot.readTimes()[0] == 100 && snapshot.getTime(2) == 200);
+
+    //  Readings not written again are carried over through every buffer
+    double* values = snapshot.write(1, 2, 300);
+    EXPECT(values != NULL && values[1] == -3);
+    values[0] = 7;
+    values[1] = 8;
+    EXPECT(snapshot.publish());
+    snapshot.set(1, 9, 400);
+    EXPECT(snapshot.publish());
+    snapshot.set(2, 10, 500);
+    EXPECT(snapshot.publish());
+    EXPECT(snapshot.getSequence() == 4);
+    double copied[3];
+    snapshot.copy(copied, 0, 3);
+    EXPECT(copied[0] == 1.5 && copied[1] == 9 && copied[2] == 10);
+    EXPECT(snapshot.getTime(0) == 100 && snapshot.getTime(1) == 400 && snapshot.getTime(2) == 500);
+}
+
+void testTornRead() {
+    Snapshot snapshot(2);
+    interrupted = &snapshot;
+    snapshot.set(0, 1, 0);
+    snapshot.set(1, 1, 0);
+    snapshot.publish();
+    double copied[2];
+
+    //  One publish part way through leaves the buffer being read alone, so the read carries on
+    steps = 0;
+    interruptAt = 0;
+    publishes = 1;
+    snapshot.copy(copied, 0, 2);
+    EXPECT(steps == 2);
+    EXPECT(copied[0] == 1 && copied[1] == 1);
+
+    //  Two publishes and a write reuse the buffer being read, which tears the read, so it is read again
+    steps = 0;
+    publishes = 2;
+    snapshot.copy(copied, 0, 2);
+    EXPECT(steps == 4);
+    EXPECT(copied[0] == 20 && copied[1] == 20);
+
+    //  The same goes for reading one value
+    steps = 0;
+    EXPECT(snapshot.get(1) == 20);
+    EXPECT(steps == 2);
+    EXPECT(snapshot.get(1) == 20);
+    interruptAt = -1;
+}
+
+int main() {
+    testPublish();
+    testTornRead();
+    return testResult();
+}
@@ -0,0 +1,246 @@
+// Tests that telemetry frames decode back to the readings they were encoded from,
+// and that the decoder throws away corrupted frames and finds its place again
+
+#include "sensorManager.hpp"
+#include "telemetryDecoder.hpp"
+#include "clock.hpp"
+#include "test.hpp"
+
+using namespace Sensor;
+
+//  Whether a decoded value is the reading it was encoded from, to within the rounding of its decimal places
+bool near(double decoded, double reading, uint8_t places) {
+    return fabs(decoded - reading) <= 0.5 / telemetryScale(places) + 1e-9;
+}
+
+void testRoundTrip() {
+    Telemetry telemetry;
+    TelemetryDecoder decoder;
+    telemetry.setDecimals(2, 0);
+    decoder.setDecimals(2, 0);
+    telemetry.setDecimals(3, 6);
+    decoder.setDecimals(3, 6);
+
+    double readings[] = {12.3456, -0.0004, -7.5, 3.14159265, 0};
+    uint8_t buffer[TELEMETRY_FRAME_SIZE(TELEMETRY_MAX_CHANNELS)];
+    int length = telemetry.encode(buffer, sizeof(buffer), readings, 5, 0xFFFFFFFF, 123456);
+    EXPECT(length == TELEMETRY_FRAME_SIZE(5));
+
+    //  Only the last byte finishes the frame
+    for (int i = 0; i < length - 1; i++) {
+        EXPECT(!decoder.push(buffer[i]));
+    }
+    EXPECT(decoder.push(buffer[length - 1]));
+
+    const TelemetryFrame& frame = decoder.getFrame();
+    EXPECT(frame.sequence == 0);
+    EXPECT(frame.timestamp == 123456);
+    EXPECT(frame.channels == 0x1F);     //  Channels past the readings are left out of the bitmap
+    EXPECT(near(decoder.getValue(0), 12.3456, 3));
+    EXPECT(near(decoder.getValue(1), -0.0004, 3));
+    EXPECT(decoder.getValue(2) == -8);  //  Rounded away from 0
+    EXPECT(near(decoder.getValue(3), 3.14159265, 6));
+    EXPECT(decoder.getValue(4) == 0);
+    EXPECT(!decoder.hasValue(5));
+    EXPECT(decoder.getFrames() == 1);
+    EXPECT(decoder.getCrcErrors() == 0);
+}
+
+void testSpecialValues() {
+    //  NaN comes back as NaN, and readings too big for their decimal places are clamped rather than wrapped
+    Telemetry telemetry;
+    TelemetryDecoder decoder;
+    double readings[] = {NAN, 1e12, -1e12, 2147483.647, INFINITY};
+    uint8_t buffer[TELEMETRY_FRAME_SIZE(5)];
+    int length = telemetry.encode(buffer, sizeof(buffer), readings, 5, 0x1F, 0);
+    EXPECT(decoder.decode(buffer, length) == 1);
+    EXPECT(isnan(decoder.getValue(0)));
+    EXPECT(decoder.getValue(1) == TELEMETRY_MAX_VALUE / 1000.0);
+    EXPECT(decoder.getValue(2) == -TELEMETRY_MAX_VALUE / 1000.0);
+    EXPECT(decoder.getValue(3) == TELEMETRY_MAX_VALUE / 1000.0);
+    EXPECT(decoder.getValue(4) == TELEMETRY_MAX_VALUE / 1000.0);
+
+    //  A buffer too small for the frame isn't written to
+    ErrorRecord record;
+    while (errorLog.pop(record)) {}
+    EXPECT(telemetry.encode(buffer, TELEMETRY_FRAME_SIZE(4), readings, 5, 0x1F, 0) == 0);
+    EXPECT(errorLog.pop(record) && record.code == ERR_TELEMETRY_BUFFER_TOO_SMALL);
+    EXPECT(telemetry.getSequence() == 1);
+}
+
+void testBitmap() {
+    //  Only the channels in the bitmap are sent, lowest first
+    Telemetry telemetry;
+    TelemetryDecoder decoder;
+    double readings[] = {1, 2, 3, 4};
+    uint8_t buffer[TELEMETRY_FRAME_SIZE(4)];
+    int length = telemetry.encode(buffer, sizeof(buffer), readings, 4, 0x0A, 0);
+    EXPECT(length == TELEMETRY_FRAME_SIZE(2));
+    EXPECT(decoder.decode(buffer, length) == 1);
+    EXPECT(decoder.getFrame().channels == 0x0A);
+    EXPECT(!decoder.hasValue(0) && isnan(decoder.getValue(0)));
+    EXPECT(decoder.getValue(1) == 2);
+    EXPECT(!decoder.hasValue(2));
+    EXPECT(decoder.getValue(3) == 4);
+}
+
+void testCorruption() {
+    //  A frame with a flipped bit is thrown away, and the next frame shows it as lost
+    Telemetry telemetry;
+    TelemetryDecoder decoder;
+    double readings[] = {1.5, 2.5};
+    uint8_t frames[3][TELEMETRY_FRAME_SIZE(2)];
+    int length = 0;
+    for (int i = 0; i < 3; i++) {
+        length = telemetry.encode(frames[i], sizeof(frames[i]), readings, 2, 0x03, i * 100);
+    }
+    frames[1][TELEMETRY_HEADER_SIZE + 1] ^= 0x10;
+
+    EXPECT(decoder.decode(frames[0], length) == 1);
+    EXPECT(decoder.decode(frames[1], length) == 0);
+    EXPECT(decoder.decode(frames[2], length) == 1);
+    EXPECT(decoder.getFrames() == 2);
+    EXPECT(decoder.getCrcErrors() == 1);
+    EXPECT(decoder.getLostFrames() == 1);
+    EXPECT(decoder.getFrame().sequence == 2);
+    EXPECT(decoder.getFrame().timestamp == 200);
+}
+
+void testResync() {
+    //  Noise, including the sync bytes, and a frame cut short don't stop the frames after them being found
+    //  The cut frame takes bytes from the frames after it until its CRC fails, then they are searched again
+    Telemetry telemetry;
+    TelemetryDecoder decoder;
+    double readings[] = {42, -42, 0.125};
+    uint8_t frames[4][TELEMETRY_FRAME_SIZE(3)];
+    int length = 0;
+    for (int i = 0; i < 4; i++) {
+        length = telemetry.encode(frames[i], sizeof(frames[i]), readings, 3, 0x07, i * 1000);
+    }
+
+    uint8_t noise[] = {0x00, 0xA5, 0xA5, 0x5A, 0xFF, 0x13, 0xA5};
+    uint8_t stream[sizeof(noise) + TELEMETRY_FRAME_SIZE(3) * 4];
+    int size = 0;
+    memcpy(stream, noise, sizeof(noise));
+    size += sizeof(noise);
+    memcpy(stream + size, frames[0], 10);   //  The first frame loses its values and CRC
+    size += 10;
+    for (int i = 1; i < 4; i++) {
+        memcpy(stream + size, frames[i], length);
+        size += length;
+    }
+
+    int found = 0;
+    for (int i = 0; i < size; i++) {
+        if (decoder.push(stream[i])) found++;
+    }
+    EXPECT(found == 3);
+    EXPECT(decoder.getFrames() == 3);
+    EXPECT(decoder.getCrcErrors() >= 1);
+    EXPECT(decoder.getLostFrames() == 0);
+    EXPECT(decoder.getFrame().sequence == 3);
+    EXPECT(decoder.getFrame().timestamp == 3000);
+    EXPECT(decoder.getValue(0) == 42);
+    EXPECT(decoder.getValue(1) == -42);
+    EXPECT(decoder.getValue(2) == 0.125);
+}
+
+//  A sensor that reports a scripted series of readings
+class ScriptSensor : public Sensor::Sensor {
+public:
+    const double* script;
+    int length;
+    int reports = 0;
+    ScriptSensor(const double* values, int count) : script(values), length(count) {}
+    void tick() {}
+    double report() {
+        double reading = script[reports < length ? reports : length - 1];
+        reports++;
+        return reading;
+    }
+};
+
+TelemetryDecoder managerDecoder;
+uint32_t decodedChannels[16];
+double decodedValues[16];
+int decodedFrames = 0;
+
+void decodeFrame(uint8_t* frame, int length) {
+    //  Feeds the manager's frames to the decoder, as a serial port would on the host
+    for (int i = 0; i < length; i++) {
+        if (managerDecoder.push(frame[i]) && decodedFrames < 16) {
+            decodedChannels[decodedFrames] = managerDecoder.getFrame().channels;
+            decodedValues[decodedFrames] = managerDecoder.getValue(0);
+            decodedFrames++;
+        }
+    }
+}
+
+void testOnChange() {
+    //  With on change reporting, the first frame sends every reading and later ones only what moved past the deadband
+    hostHal.reset();
+    const double steps[] = {1, 1.2, 3, 3, NAN, NAN, 5};
+    const double steady[] = {7};
+    ScriptSensor stepping(steps, 7);
+    ScriptSensor constant(steady, 1);
+    stepping.setReportRate(100);
+    constant.setReportRate(100);
+
+    SensorManager manager(2, 100);
+    manager.setFrameCallback(decodeFrame);
+    manager.setOnChange(true);
+    manager.setDeadband(0, 0.5);
+    manager.addSensor(&stepping);
+    manager.addSensor(&constant);
+    manager.spin(750);
+
+    EXPECT(stepping.reports == 7);
+    EXPECT(decodedFrames == 4);
+    EXPECT(decodedChannels[0] == 0x03);
+    EXPECT(managerDecoder.getCrcErrors() == 0);
+    EXPECT(managerDecoder.getLostFrames() == 0);
+    EXPECT(decodedValues[0] == 1);
+    EXPECT(decodedChannels[1] == 0x01 && decodedValues[1] == 3);
+    EXPECT(decodedChannels[2] == 0x01 && isnan(decodedValues[2]));
+    EXPECT(decodedChannels[3] == 0x01 && decodedValues[3] == 5);
+}
+
+void testClockDecimals() {
+    //  The clock's seconds since 2024 keep no decimal places, so a time in 2026 isn't clamped
+    hostHal.reset();
+    hostHal.setRtc(1704067200 + 88000000);
+    Clock clock;
+    clock.setReportRate(100);
+    clock.setup();
+    const double steady[] = {1.25};
+    ScriptSensor other(steady, 1);
+    other.setReportRate(100);
+
+    SensorManager manager(2, 100);
+    manager.addSensor(&other);
+    manager.addSensor(&clock);
+    EXPECT(manager.getTelemetry().getDecimals(0) == TELEMETRY_DEFAULT_DECIMALS);
+    EXPECT(manager.getTelemetry().getDecimals(1) == 0);
+    manager.spin(150);
+
+    TelemetryDecoder decoder;
+    decoder.setDecimals(1, 0);
+    uint8_t buffer[TELEMETRY_FRAME_SIZE(2)];
+    int length = manager.encodeFrame(buffer, sizeof(buffer), 0x03);
+    EXPECT(decoder.decode(buffer, length) == 1);
+    EXPECT(decoder.getValue(0) == 1.25);
+    double time = decoder.getValue(1);
+    EXPECT(time != TELEMETRY_MAX_VALUE);
+    EXPECT(time >= 88000000 && time <= 88000001);
+}
+
+int main() {
+    testRoundTrip();
+    testSpecialValues();
+    testBitmap();
+    testCorruption();
+    testResync();
+    testOnChange();
+    testClockDecimals();
+    return testResult();
+}
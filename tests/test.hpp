@@ -0,0 +1,29 @@
+// A minimal test harness for the host tests, each test is a program that returns non-zero if any check failed
+//
+// Usage:
+//     EXPECT(millis() == 10);
+//     return testResult();
+
+//  A header guard prevents the file from being included twice
+#ifndef TEST_H
+#define TEST_H
+#include <stdio.h>
+
+//  The number of checks that have failed so far
+int testFailures = 0;
+
+//  Checks a condition, printing where it failed without stopping the test
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            printf("%s:%d: expected %s\n", __FILE__, __LINE__, #condition);         \
+            testFailures++;                                                         \
+        }                                                                           \
+    } while (0)
+
+int testResult() {
+    if (testFailures > 0) printf("%d checks failed\n", testFailures);
+    return testFailures > 0 ? 1 : 0;
+}
+
+#endif
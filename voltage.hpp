@@ -4,23 +4,27 @@
 #ifndef VOLTAGE_H
 #define VOLTAGE_H
 #include "sensor.hpp" //  Include the parent sensor
+#include "adcStream.hpp"//  Reads pause the ADC stream if it is running
+#include "fixed.hpp"//  Readings are converted with fixed point maths
 
 namespace Sensor {
     class VoltageSensor : public Sensor {
     private:
-        uint8_t vin;        //  Voltage input pin
-        double gradient;    //  Gradient produced by potential divider, used for calibration
+        AnalogInput vin;    //  Voltage input pin
+        Fixed scale;        //  Volts per ADC code, folded from the potential divider gradient
     public:
         VoltageSensor(uint8_t pin, double grad);   //  Called when a new sensor object is created
         ~VoltageSensor();   //  Called when a sensor object is destroyed
         void tick();        //  Both called by the sensor manager
         double report();
+        void attach(Acquisition& acquisition);
+        Fixed reportFixed();    //  The reading in volts, without any floating point maths
     };
 
-    VoltageSensor::VoltageSensor(uint8_t pin, double grad) {
+    VoltageSensor::VoltageSensor(uint8_t pin, double grad) : vin(pin) {
         //  Setup and store the input pin and gradient
-        vin = pin;
-        gradient = grad;
+        //  5/1023 -- is the ratio of voltage to bits, folded with the gradient once here rather than on every report
+        scale = Fixed(5.0 / 1023.0 * grad);
         pinMode(pin, INPUT);
     }
 
@@ -29,15 +33,30 @@ namespace Sensor {
     }
 
     void VoltageSensor::tick() {
-        //  We don't bother averaging
+        //  Samples are only taken on ticks when there is a filter to average them
+        if (filter != NULL) {
+            filter->push(vin.read());
+        }
+    }
+
+    void VoltageSensor::attach(Acquisition& acquisition) {
+        //  Read the input pin in the sensor manager's acquisition pass
+        vin.attach(acquisition);
     }
 
     double VoltageSensor::report() {
         //  Called by the sensor manager whenever a reading should be reported
-        //  Read from the input pin and calculate the voltage before the potential divider
-        double reading = (double)analogRead(vin);
-        double voltage = reading * (5.0/1023.0) * gradient;// 5/1023 -- is the ratio of voltage to bits
-        return voltage;
+        return reportFixed().toDouble();
+    }
+
+    Fixed VoltageSensor::reportFixed() {
+        //  Use the filtered reading if there is one, otherwise read from the input pin
+        Fixed reading = filter != NULL && filter->ready() ? filter->output() : Fixed(vin.read());
+        if (calibration != NULL) {
+            return calibration->convert(reading);
+        }
+        //  Calculate the voltage before the potential divider
+        return scale * reading;
     }
 }
 
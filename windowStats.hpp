@@ -0,0 +1,108 @@
+// Window statistics summarise every sample taken between two reports, so a sensor can report the peaks
+// and ripple of a signal as well as its average, without reporting any faster
+// Each sample costs a few integer additions and one multiply, the statistics are only worked out when reported
+//
+// The sums are kept relative to the first sample of the window, so a large steady offset
+// doesn't swamp a small variance when the sum of squares has the square of the sum taken off it
+// A window can hold 32768 samples swinging across the whole 16 bit range, and millions of 10 bit ADC samples
+
+//  A header guard prevents the file from being included twice
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+#include "check.hpp"
+
+namespace Sensor {
+    class WindowStats {
+    private:
+        unsigned long count;    //  The samples in the window
+        int16_t first;      //  The first sample, which the sums are relative to
+        int16_t minimum;
+        int16_t maximum;
+        int32_t sum;        //  The sum of the samples minus the first
+        uint32_t squaresLow;    //  The sum of the squares of the samples minus the first,
+        uint16_t squaresHigh;   //  48 bits so a long window can't overflow it
+    public:
+        WindowStats();
+        void reset();
+        void add(int16_t sample);
+        unsigned long getCount();
+        int16_t getMin();
+        int16_t getMax();
+        double getMean();
+        double getVariance();
+        double getDeviation();
+        double getRms();
+    };
+
+    WindowStats::WindowStats() {
+        reset();
+    }
+
+    void WindowStats::reset() {
+        //  Starts a new window
+        count = 0;
+        first = 0;
+        minimum = 0;
+        maximum = 0;
+        sum = 0;
+        squaresLow = 0;
+        squaresHigh = 0;
+    }
+
+    void WindowStats::add(int16_t sample) {
+        if (count == 0) {
+            first = sample;
+            minimum = sample;
+            maximum = sample;
+        }
+        if (sample < minimum) minimum = sample;
+        if (sample > maximum) maximum = sample;
+
+        int32_t offset = (int32_t)sample - first;
+        sum += offset;
+        uint32_t magnitude = offset < 0 ? -offset : offset;
+        uint32_t square = magnitude * magnitude;    //  Up to 65535 squared, which only just fits unsigned
+        uint32_t before = squaresLow;
+        squaresLow += square;
+        if (squaresLow < before) squaresHigh++;     //  Carry into the top 16 bits
+        count++;
+    }
+
+    unsigned long WindowStats::getCount() {
+        return count;
+    }
+
+    int16_t WindowStats::getMin() {
+        return minimum;
+    }
+
+    int16_t WindowStats::getMax() {
+        return maximum;
+    }
+
+    double WindowStats::getMean() {
+        if (count == 0) return NAN;
+        return first + (double)sum / count;
+    }
+
+    double WindowStats::getVariance() {
+        //  The population variance, the mean square of the offsets less the square of their mean
+        if (count == 0) return NAN;
+        double squares = squaresHigh * 4294967296.0 + squaresLow;
+        double mean = (double)sum / count;
+        double variance = squares / count - mean * mean;
+        return variance > 0 ? variance : 0;     //  Rounding can take a flat signal just below 0
+    }
+
+    double WindowStats::getDeviation() {
+        return sqrt(getVariance());
+    }
+
+    double WindowStats::getRms() {
+        //  The root of the mean square, which is the variance plus the square of the mean
+        double mean = getMean();
+        return sqrt(getVariance() + mean * mean);
+    }
+}
+
+#endif